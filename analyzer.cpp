@@ -18,6 +18,9 @@
 
 #include "analyzer.h"
 
+#include "logger.h"
+#include "profiler.h"
+#include "snapshot.h"
 #include "translator.h"
 #include "yaml.h"
 
@@ -57,7 +60,177 @@ public:
     }
 };
 
-Analyzer::models_t Analyzer::_allModels {};
+ModelRegistry::Lock::Lock(ModelRegistry* registry, const string* key,
+                          unique_lock<mutex> lock)
+    : _registry(registry), _key(key), _lock(move(lock))
+{}
+
+ModelRegistry::Lock::Lock(Lock&& other) noexcept
+    : _registry(exchange(other._registry, nullptr))
+    , _key(exchange(other._key, nullptr))
+    , _lock(move(other._lock))
+{}
+
+ModelRegistry::Lock& ModelRegistry::Lock::operator=(Lock&& other) noexcept
+{
+    if (this != &other) {
+        unlock();
+        _registry = exchange(other._registry, nullptr);
+        _key = exchange(other._key, nullptr);
+        _lock = move(other._lock);
+    }
+    return *this;
+}
+
+void ModelRegistry::Lock::unlock()
+{
+    if (!_registry)
+        return;
+    {
+        const lock_guard l(_registry->_mutex);
+        _registry->_owners.erase(*_key);
+    }
+    _lock.unlock();
+    _registry = nullptr;
+}
+
+ModelRegistry::LockedModel ModelRegistry::lock(const string& key)
+{
+    unique_lock registryLock(_mutex);
+    auto [mIt, unseen] = _models.try_emplace(key);
+    auto& modelMutex = _modelLocks[key];
+    const auto thisThread = this_thread::get_id();
+    // Nobody else can know about a new model, so locking it right away
+    // (before releasing the registry) won't block; otherwise, wait for
+    // the model outside of the registry lock as it can take long.
+    if (!unseen) {
+        // Follow the owner of the model, the model that owner waits for,
+        // the owner of that one and so on; if this comes back to this
+        // thread, the threads would wait for each other forever
+        for (auto ownerIt = _owners.find(key); ownerIt != _owners.end();) {
+            if (ownerIt->second == thisThread)
+                throw Exception("Circular reference to " + key);
+            const auto awaitedIt = _awaitedKeys.find(ownerIt->second);
+            if (awaitedIt == _awaitedKeys.end())
+                break;
+            ownerIt = _owners.find(awaitedIt->second);
+        }
+        _awaitedKeys.insert_or_assign(thisThread, key);
+        registryLock.unlock();
+    }
+    unique_lock modelLock(modelMutex);
+    if (!unseen) {
+        registryLock.lock();
+        _awaitedKeys.erase(thisThread);
+    }
+    _owners.insert_or_assign(key, thisThread);
+    return { mIt->second, Lock(this, &mIt->first, move(modelLock)), unseen };
+}
+
+void ModelRegistry::clear()
+{
+    const lock_guard l(_mutex);
+    _models.clear();
+    _modelLocks.clear();
+    _updatedKeys.clear();
+    _owners.clear();
+    _awaitedKeys.clear();
+}
+
+void ModelRegistry::erase(const string& key)
+{
+    const lock_guard l(_mutex);
+    _models.erase(key);
+    _modelLocks.erase(key);
+    _updatedKeys.erase(key);
+    _owners.erase(key);
+}
+
+void ModelRegistry::markUpdated(const string& key)
+{
+    const lock_guard l(_mutex);
+    _updatedKeys.insert(key);
+}
+
+set<string> ModelRegistry::takeUpdated()
+{
+    const lock_guard l(_mutex);
+    return exchange(_updatedKeys, {});
+}
+
+ModelRegistry defaultRegistry {};
+ModelRegistry* Analyzer::_allModels = &defaultRegistry;
+YamlDocumentCache Analyzer::_documents {};
+map<string, InOut> Analyzer::_requiredRoles {};
+
+set<string> Analyzer::dependentModels(const set<fspath>& changedFiles)
+{
+    set<fspath> changedPaths;
+    for (const auto& fPath: changedFiles)
+        changedPaths.insert(fs::weakly_canonical(fPath));
+
+    set<string> changedKeys;
+    for (const auto& [key, model]: allModels())
+        if (changedPaths.contains(fs::weakly_canonical(model.srcPath)))
+            changedKeys.insert(key);
+    return dependencyGraph().withDependents(changedKeys);
+}
+
+void Analyzer::forgetModels(const set<string>& keys)
+{
+    for (const auto& key: keys)
+        _allModels->erase(key);
+}
+
+set<string> Analyzer::restoreModels(ModelSnapshot& snapshot,
+                                   const set<string>& keys,
+                                   const Translator& translator)
+{
+    const Profiler::Scope profileScope { "restore snapshot" };
+    set<string> restoredKeys;
+    unordered_set<string> visitedKeys;
+    vector<string> keysToVisit { keys.begin(), keys.end() };
+    while (!keysToVisit.empty()) {
+        const auto key = move(keysToVisit.back());
+        keysToVisit.pop_back();
+        if (!visitedKeys.insert(key).second)
+            continue;
+        const auto& dependencies = snapshot.dependencies(key);
+        keysToVisit.insert(keysToVisit.end(), dependencies.begin(),
+                           dependencies.end());
+        if (!snapshot.upToDate(key))
+            continue;
+        auto [model, modelLock, unseen] = _allModels->lock(key);
+        if (!unseen)
+            continue;
+        try {
+            snapshot.restore(key, model, translator);
+        } catch (const Exception& e) {
+            // A model without the models it refers to is of no use
+            GTAD_WARNING << "Warning: couldn't restore " << key
+                         << " from the snapshot: " << e.message;
+            modelLock.unlock();
+            restoredKeys.insert(key);
+            forgetModels(restoredKeys);
+            return {};
+        }
+        GTAD_DEBUG << "Restored the model for " << key << " from the snapshot";
+        restoredKeys.insert(key);
+    }
+    return restoredKeys;
+}
+
+void Analyzer::clearDocumentCache() { _documents.clear(); }
+
+void Analyzer::dropUnusedPreloads()
+{
+    vector<string> unusedKeys;
+    for (const auto& [key, model]: allModels())
+        if (model.preloaded)
+            unusedKeys.push_back(key);
+    for (const auto& key: unusedKeys)
+        _allModels->erase(key);
+}
 
 Analyzer::Analyzer(const Translator& translator, fspath basePath)
     : _baseDir(move(basePath))
@@ -65,8 +238,8 @@ Analyzer::Analyzer(const Translator& translator, fspath basePath)
 {
     if (!fs::is_directory(_baseDir))
         throw Exception("Base path " + _baseDir.string() + " is not a directory");
-    cout << "Using " << _baseDir << " as a base directory for YAML/JSON files"
-         << endl;
+    GTAD_DEBUG << "Using " << _baseDir
+               << " as a base directory for YAML/JSON files";
 }
 
 TypeUsage Analyzer::analyzeTypeUsage(const YamlMap& node, IsTopLevel isTopLevel)
@@ -92,8 +265,10 @@ TypeUsage Analyzer::analyzeTypeUsage(const YamlMap& node, IsTopLevel isTopLevel)
     if (yamlType == "object")
     {
         auto schema = analyzeSchema(node);
-        if (isTopLevel && schema.empty() && currentRole() == OnlyOut)
+        if (isTopLevel && schema.empty() && currentRole() == OnlyOut) {
+            currentModel().roleSensitive = true;
             return {}; // The type returned by this API is void
+        }
 
         // If the schema is trivial it is treated as an alias for another type.
         // NB: if the found name or top-level $ref for the schema has any
@@ -109,7 +284,7 @@ TypeUsage Analyzer::analyzeTypeUsage(const YamlMap& node, IsTopLevel isTopLevel)
         // Also, a nameless non-empty schema is now treated as a generic
         // mapType("object"). TODO, low priority: ad-hoc typing (via tuples?)
     }
-    if (const auto tu = _translator.mapType(yamlType, node["format"].as<string>(""));
+    if (const auto& tu = _translator.mapType(yamlType, node["format"].as<string>(""));
         !tu.empty())
         return tu;
 
@@ -144,8 +319,8 @@ TypeUsage Analyzer::analyzeMultitype(const YamlSequence& yamlTypes)
     }
 
     const auto& protoType = _translator.mapType("variant", baseTypes, baseTypes);
-    cout << logOffset() << "Using " << protoType.qualifiedName()
-         << " for a multitype: " << baseTypes << endl;
+    GTAD_DEBUG << logOffset() << "Using " << protoType.qualifiedName()
+               << " for a multitype: " << baseTypes;
     return protoType.specialize(move(tus));
 }
 
@@ -155,9 +330,9 @@ ObjectSchema Analyzer::analyzeSchema(const YamlMap& yamlSchema,
     if (const auto yamlRef = yamlSchema["$ref"]) {
         // https://tools.ietf.org/html/draft-pbryan-zyp-json-ref-03#section-3
         if (yamlSchema.size() > 1)
-            clog << yamlSchema.location() << ": Warning: "
-                    "members next to $ref in the same map will be ignored"
-                 << endl;
+            GTAD_WARNING << yamlSchema.location()
+                         << ": Warning: members next to $ref in the same map"
+                            " will be ignored";
         return resolveRef(yamlRef.as<string>(), refsStrategy);
     }
 
@@ -165,21 +340,21 @@ ObjectSchema Analyzer::analyzeSchema(const YamlMap& yamlSchema,
                             ? analyzeObject(yamlSchema, refsStrategy)
                             : makeEphemeralSchema(analyzeTypeUsage(yamlSchema));
 
-    if (!schema.empty()) {
-        cout << logOffset() << yamlSchema.location() << ": schema for "
+    if (!schema.empty() && Log::enabled(Verbosity::Debug)) {
+        Log::Line line { Verbosity::Debug };
+        line << logOffset() << yamlSchema.location() << ": schema for "
              << schema;
         if (const auto& scopeName = currentScope().name; !scopeName.empty())
-            cout << '/' << scopeName;
+            line << '/' << scopeName;
         if (schema.trivial())
-            cout << " mapped to " << schema.parentTypes.front().qualifiedName();
+            line << " mapped to " << schema.parentTypes.front().qualifiedName();
         else {
-            cout << " (parent(s): " << schema.parentTypes.size()
+            line << " (parent(s): " << schema.parentTypes.size()
                  << ", field(s): " << schema.fields.size();
             if (!schema.propertyMap.type.empty())
-                cout << " and a property map";
-            cout << ")";
+                line << " and a property map";
+            line << ")";
         }
-        cout << endl;
     }
     return schema;
 }
@@ -210,8 +385,8 @@ ObjectSchema Analyzer::analyzeObject(const YamlMap& yamlSchema,
     if (!name.empty()) {
         // Now that we have a good idea of the schema identity we can check if
         // the configuration has anything to substitute this schema with.
-        if (auto&& tu = _translator.mapType("schema", name); !tu.empty())
-            return makeEphemeralSchema(move(tu));
+        if (const auto& tu = _translator.mapType("schema", name); !tu.empty())
+            return makeEphemeralSchema(TypeUsage(tu));
     }
 
     if (auto yamlOneOf = yamlSchema["oneOf"].asSequence())
@@ -223,17 +398,17 @@ ObjectSchema Analyzer::analyzeObject(const YamlMap& yamlSchema,
             // NB: If the schema is loaded from $ref, it ends up in
             // innerSchema.parentType; its name won't be in innerSchema.name
             if (!innerSchema.name.empty())
-                name = innerSchema.name;
-            std::copy(innerSchema.parentTypes.begin(),
+                name = move(innerSchema.name);
+            std::move(innerSchema.parentTypes.begin(),
                       innerSchema.parentTypes.end(),
                       std::back_inserter(schema.parentTypes));
             if (!innerSchema.description.empty())
-                schema.description = innerSchema.description;
-            for (auto&& f: innerSchema.fields) {
+                schema.description = move(innerSchema.description);
+            for (auto&& f: innerSchema.fields.take()) {
                 // Re-map the identifier name using the current schema as scope
                 // (f has been produced with innerSchema as scope)
-                f.name =
-                    _translator.mapIdentifier(f.baseName, &schema, f.required);
+                f.rename(
+                    _translator.mapIdentifier(f.baseName, &schema, f.required));
                 if (!f.name.empty())
                     addVarDecl(schema.fields, move(f));
             }
@@ -245,8 +420,8 @@ ObjectSchema Analyzer::analyzeObject(const YamlMap& yamlSchema,
                         yamlEntry, "Conflicting property map types when "
                                    "merging properties to the main schema");
 
-                pm.name = _translator.mapIdentifier(pm.baseName, &schema,
-                                                    pm.required);
+                pm.rename(_translator.mapIdentifier(pm.baseName, &schema,
+                                                    pm.required));
                 if (!pm.name.empty())
                     schema.propertyMap = move(pm);
             }
@@ -355,51 +530,55 @@ Body Analyzer::analyzeBodySchema(const YamlMap& yamlSchema, const string& name,
             // No parents, non-empty - unpack the schema to body properties
             currentModel().addImportsFrom(bodySchema);
             // NOLINTNEXTLINE(cppcoreguidelines-slicing): no parents to lose
-            return FlatSchema {bodySchema};
+            return FlatSchema {move(bodySchema)};
         }
     }
     if (auto&& v = makeVarDecl(move(packedType), name, location,
                                move(description), required)) {
-        cout << logOffset() << yamlSchema.location() << ": substituting the "
-             << location << " schema with a '" << v->type.qualifiedName() << ' '
-             << v->name << "' parameter" << endl;
-        return *v;
+        GTAD_DEBUG << logOffset() << yamlSchema.location()
+                   << ": substituting the " << location << " schema with a '"
+                   << v->type.qualifiedName() << ' ' << v->name
+                   << "' parameter";
+        return move(*v);
     }
-    cout << logOffset() << yamlSchema.location() << location
-         << " schema has been nullified by configuration" << endl;
+    GTAD_DEBUG << logOffset() << yamlSchema.location() << location
+               << " schema has been nullified by configuration";
     return {};
 }
 
 ObjectSchema Analyzer::resolveRef(const string& refPath,
                                   RefsStrategy refsStrategy)
 {
+    Profiler::count(Profiler::RefsResolved);
     // First try to resolve refPath in types map
-    auto&& tu = _translator.mapType("$ref", refPath);
+    auto tu = _translator.mapType("$ref", refPath);
     if (tu.empty()) {
         // No type shortcut in the types map (but tu may have some attributes
         // loaded by mapType() above)
-        const auto titleIt = tu.attributes.find("title");
+        const auto& attributes = tu.attributes();
+        const auto titleIt = attributes.find("title");
         const auto& overrideTitle =
-            titleIt != tu.attributes.cend() ? titleIt->second : string();
+            titleIt != attributes.cend() ? titleIt->second : string();
         // Take the configuration override into account
-        if (auto inlineAttrIt = tu.attributes.find("_inline");
-            inlineAttrIt != tu.attributes.end() && inlineAttrIt->second == "true")
+        if (auto inlineAttrIt = attributes.find("_inline");
+            inlineAttrIt != attributes.end() && inlineAttrIt->second == "true")
             refsStrategy = InlineRefs;
-        auto&& [refModel, importPath] =
+        auto&& [refModel, importPath, refModelLock] =
             loadDependency(refPath, overrideTitle, refsStrategy == InlineRefs);
         if (refModel.types.empty())
             throw Exception(refPath + " has no schemas");
 
-        tu.addImport(importPath.string());
+        _translator.addImport(tu, importPath.string());
         auto&& refSchema = refModel.types.back();
 
         if (refsStrategy == InlineRefs || refModel.trivial()) {
             if (refModel.trivial())
-                cout << logOffset() << "The model at " << refPath
-                     << " is trivial (see the mapping above) and";
+                GTAD_DEBUG << logOffset() << "The model at " << refPath
+                           << " is trivial (see the mapping above) and"
+                              " will be inlined";
             else
-                cout << logOffset() << "The main schema from " << refPath;
-            cout << " will be inlined" << endl;
+                GTAD_DEBUG << logOffset() << "The main schema from " << refPath
+                           << " will be inlined";
 
             currentModel().imports.insert(refModel.imports.begin(),
                                           refModel.imports.end());
@@ -407,8 +586,8 @@ ObjectSchema Analyzer::resolveRef(const string& refPath,
             // depends on other definitions from the same file; but it's
             // not always practical to inline dependencies as well
             if (refModel.types.size() > 1) {
-                cout << "The dependencies will still be imported from "
-                     << importPath << endl;
+                GTAD_DEBUG << "The dependencies will still be imported from "
+                           << importPath;
                 currentModel().addImportsFrom(tu); // One import actually
             }
             return refSchema;
@@ -416,8 +595,8 @@ ObjectSchema Analyzer::resolveRef(const string& refPath,
         tu.name = refSchema.name;
         tu.baseName = tu.name.empty() ? refPath : tu.name;
     }
-    cout << logOffset() << "Resolved $ref: " << refPath << " to type usage "
-         << tu.name << endl;
+    GTAD_DEBUG << logOffset() << "Resolved $ref: " << refPath
+               << " to type usage " << tu.name;
 
     return makeEphemeralSchema(move(tu));
 }
@@ -445,16 +624,8 @@ optional<VarDecl> Analyzer::makeVarDecl(TypeUsage type, const string& baseName,
 
 void Analyzer::addVarDecl(VarDecls &varList, VarDecl &&v) const
 {
-    varList.erase(remove_if(varList.begin(), varList.end(),
-                            [&v, this](const VarDecl& vv) {
-                                if (v.name != vv.name)
-                                    return false;
-                                cout << logOffset() << "Re-defining field "
-                                     << vv << endl;
-                                return true;
-                            }),
-                  varList.end());
-    varList.emplace_back(v);
+    if (const auto& vv = varList.add(move(v)))
+        GTAD_DEBUG << logOffset() << "Re-defining field " << *vv;
 }
 
 void Analyzer::addVarDecl(VarDecls& varList, TypeUsage type,
@@ -467,9 +638,9 @@ void Analyzer::addVarDecl(VarDecls& varList, TypeUsage type,
         addVarDecl(varList, move(*v));
 }
 
-inline auto makeModelKey(const string& filePath)
+string Analyzer::makeModelKey(const string& filePath)
 {
-    return withoutSuffix(filePath, ".yaml");
+    return string(withoutSuffix(filePath, ".yaml"));
 }
 
 vector<string> loadContentTypes(const YamlMap& yaml, const char* keyName)
@@ -479,17 +650,75 @@ vector<string> loadContentTypes(const YamlMap& yaml, const char* keyName)
     return {};
 }
 
+void collectReferences(const YAML::Node& node, vector<string>& refs)
+{
+    if (node.IsMap()) {
+        if (const auto& refNode = node["$ref"]; refNode && refNode.IsScalar())
+            refs.push_back(refNode.Scalar());
+        for (const auto& [keyNode, valueNode]: node)
+            if (const auto& key = keyNode.Scalar();
+                key != "example" && key != "examples")
+                collectReferences(valueNode, refs);
+    } else if (node.IsSequence())
+        for (const auto& itemNode: node)
+            collectReferences(itemNode, refs);
+}
+
+vector<string> Analyzer::scanReferences(const string& filePath) const
+{
+    const Profiler::Scope profileScope { "scan references", filePath };
+    vector<string> refs;
+    try {
+        collectReferences(
+            _documents.load(_baseDir / filePath, _translator.substitutions()),
+            refs);
+    } catch (const std::exception& e) {
+        GTAD_DEBUG << "Could not scan " << filePath << " for references: "
+                   << e.what();
+        return {};
+    }
+    vector<string> result;
+    for (const auto& ref: refs)
+        if (!ref.empty() && ref.front() != '#'
+            && _translator.mapType("$ref", ref).empty())
+            result.push_back((fspath(filePath).parent_path() / ref).string());
+    return result;
+}
+
+void Analyzer::preloadDependency(const string& filePath)
+{
+    const auto key = makeModelKey(filePath);
+    auto [model, modelLock, unseen] = _allModels->lock(key);
+    if (!unseen) // Something has loaded it already
+        return;
+
+    model.preloaded = true;
+    try {
+        // The same role as loadDependency() gives to a model seen first
+        analyzeDataModel(model, filePath, key,
+                         withRequiredRole(key, InAndOut));
+    } catch (const std::exception& e) {
+        GTAD_DEBUG << "Could not preload " << filePath << ": " << e.what();
+        _modelsInProgress.erase(key);
+        model.clear();
+        model.preloaded = true;
+    }
+}
+
 const Model& Analyzer::loadModel(const string& filePath, InOut inOut)
 {
-    cout << "Loading from " << filePath << endl;
+    const Profiler::Scope profileScope { "analyze", filePath };
+    GTAD_INFO << "Loading from " << filePath;
     const auto yaml =
-        YamlMap::loadFromFile(_baseDir / filePath, _translator.substitutions());
-    if (_allModels.count(filePath) > 0) {
-        clog << "Warning: the model has been loaded from " << filePath
-             << " but will be reloaded again" << endl;
-        _allModels.erase(filePath);
+        _documents.load(_baseDir / filePath, _translator.substitutions());
+    auto&& [model, modelLock, unseen] =
+        _allModels->lock(makeModelKey(filePath));
+    if (!unseen) {
+        GTAD_WARNING << "Warning: the model has been loaded from " << filePath
+                     << " but will be reloaded again";
+        model.clear();
     }
-    auto&& model = _allModels[makeModelKey(filePath)];
+    model.srcPath = (_baseDir / filePath).string();
     ContextOverlay _modelContext(*this, fspath(filePath).parent_path(), &model);
 
     // Detect which file we have: API description or data definition
@@ -526,9 +755,9 @@ const Model& Analyzer::loadModel(const string& filePath, InOut inOut)
                 if (const auto security = yamlCall["security"].asSequence())
                     needsSecurity = security[0]["accessToken"].IsDefined();
 
-                cout << logOffset() << yamlCall.location()
-                     << ": Found operation " << operationId
-                     << " (" << path << ", " << verb << ')' << endl;
+                GTAD_DEBUG << logOffset() << yamlCall.location()
+                           << ": Found operation " << operationId
+                           << " (" << path << ", " << verb << ')';
 
                 Call& call = model.addCall(path, move(verb), move(operationId),
                                            needsSecurity);
@@ -560,10 +789,11 @@ const Model& Analyzer::loadModel(const string& filePath, InOut inOut)
                     auto&& in = yamlParam.get("in").as<string>();
                     auto required = yamlParam["required"].as<bool>(false);
                     if (!required && in == "path") {
-                        cout << logOffset() << yamlParam.location()
-                        	 << ": warning: '" << name
-                             << "' is in path but has no 'required' attribute"
-                             << " - treating as required anyway" << endl;
+                        GTAD_WARNING
+                            << logOffset() << yamlParam.location()
+                            << ": warning: '" << name
+                            << "' is in path but has no 'required' attribute"
+                            << " - treating as required anyway";
                         required = true;
                     }
 //                    cout << "Parameter: " << name << endl;
@@ -611,18 +841,30 @@ const Model& Analyzer::loadModel(const string& filePath, InOut inOut)
     return model;
 }
 
-pair<const Model&, fs::path>
-Analyzer::loadDependency(const string& relPath, const string& overrideTitle,
-                         bool inlined)
+Analyzer::Dependency Analyzer::loadDependency(const string& relPath,
+                                              const string& overrideTitle,
+                                              bool inlined)
 {
     const auto& fullPath = context().fileDir / relPath;
     const auto fullPathBase = makeModelKey(fullPath.string());
-    const auto [mIt, unseen] = _allModels.try_emplace(fullPathBase);
-    auto& model = mIt->second;
-    const pair result {cref(model), _translator.outputBaseDir() / fullPathBase};
+    if (_modelsInProgress.contains(fullPathBase))
+        throw Exception("Circular reference to " + relPath + " in "
+                        + context().fileDir.string());
+    currentModel().dependencies.insert(fullPathBase);
+    auto [model, modelLock, unseen] = _allModels->lock(fullPathBase);
+    auto importPath = _translator.outputBaseDir() / fullPathBase;
 
     // If there is a matching model just return it
     auto modelRole = InAndOut;
+    if (!unseen && model.preloaded) {
+        model.preloaded = false;
+        if (!model.types.empty()) {
+            GTAD_DEBUG << logOffset() << "Using preloaded model for " << relPath;
+            return finishDependency(model, true, overrideTitle, inlined,
+                                    move(importPath), move(modelLock));
+        }
+        unseen = true; // The preload failed, load again to report the errors
+    }
     if (!unseen) {
         if (model.apiSpec != ApiSpec::JSONSchema)
             throw Exception("Dependency model for " + relPath
@@ -636,39 +878,108 @@ Analyzer::loadDependency(const string& relPath, const string& overrideTitle,
         if (!model.types.empty()) {
             modelRole = model.types.back().role;
             if (modelRole == InAndOut || modelRole == currentRole()) {
-                cout << logOffset() << "Reusing already loaded model for "
-                     << relPath << " with role " << modelRole << endl;
-                return result;
+                GTAD_DEBUG << logOffset() << "Reusing already loaded model for "
+                           << relPath << " with role " << modelRole;
+                return { model, move(importPath), move(modelLock) };
+            }
+            if (widenRoles(fullPathBase, model)) {
+                GTAD_DEBUG << logOffset() << "Extended existing data model for "
+                           << relPath << " from role " << modelRole
+                           << " to all roles";
+                return finishDependency(model, unseen, overrideTitle, inlined,
+                                        move(importPath), move(modelLock));
             }
-            cout << logOffset()
-                 << "Found existing data model generated for role " << modelRole
-                 << "; the model will be reloaded for all roles" << endl;
+            GTAD_DEBUG << logOffset()
+                       << "Found existing data model generated for role "
+                       << modelRole
+                       << "; the model will be reloaded for all roles";
             modelRole = InAndOut;
             model.clear();
+            _allModels->markUpdated(fullPathBase);
         } else {
-            cout << logOffset() << "Warning: empty data model for " << relPath
-                 << " has been found in the cache; reloading" << endl;
+            GTAD_WARNING << logOffset() << "Warning: empty data model for "
+                         << relPath
+                         << " has been found in the cache; reloading";
+            _allModels->markUpdated(fullPathBase);
             modelRole = currentRole();
         }
     }
+    analyzeDataModel(model, fullPath, fullPathBase,
+                     withRequiredRole(fullPathBase, modelRole));
+    return finishDependency(model, unseen, overrideTitle, inlined,
+                            move(importPath), move(modelLock));
+}
 
-    cout << logOffset() << "Loading data schema from " << relPath
-         << " with role " << modelRole << endl;
+InOut Analyzer::withRequiredRole(const string& key, InOut role)
+{
+    const auto it = _requiredRoles.find(key);
+    return it != _requiredRoles.end() ? unionRole(role, it->second) : role;
+}
+
+void Analyzer::analyzeDataModel(Model& model, const fspath& filePath,
+                                const string& key, InOut role)
+{
+    const Profiler::Scope profileScope { "analyze schema", filePath.string() };
+    GTAD_INFO << logOffset() << "Loading data schema from " << filePath
+              << " with role " << role;
     const auto yaml =
-        YamlMap::loadFromFile(_baseDir / fullPath, _translator.substitutions());
-    ContextOverlay _modelContext(*this, fullPath.parent_path(), &model,
-                                 Identifier{{}, modelRole});
-    fillDataModel(model, yaml, fspath(fullPathBase).filename());
+        _documents.load(_baseDir / filePath, _translator.substitutions());
+    ContextOverlay _modelContext(*this, filePath.parent_path(), &model,
+                                 Identifier{{}, role});
+    model.srcPath = (_baseDir / filePath).string();
+    _modelsInProgress.insert(key);
+    fillDataModel(model, yaml, fspath(key).filename());
+    _modelsInProgress.erase(key);
+}
+
+Analyzer::Dependency Analyzer::finishDependency(Model& model, bool unseen,
+                                                const string& overrideTitle,
+                                                bool inlined, fspath importPath,
+                                                ModelRegistry::lock_type lock)
+{
     auto& mainSchema = model.types.back();
     if (!overrideTitle.empty() && !model.types.empty())
-        mainSchema.name = overrideTitle;
+        model.renameSchema(mainSchema, overrideTitle);
     if (mainSchema.hasParents()
         && (!mainSchema.fields.empty() || mainSchema.hasPropertyMap()))
-        cout << logOffset() << "Inlining suppressed due to model complexity"
-             << endl;
+        GTAD_DEBUG << logOffset()
+                   << "Inlining suppressed due to model complexity";
     else
         model.inlineMainSchema = (unseen || model.inlineMainSchema) && inlined;
-    return result;
+    return { model, move(importPath), move(lock) };
+}
+
+bool Analyzer::widenRoles(const string& key, Model& model)
+{
+    // Lock all models the model refers to, directly or not, and check them
+    // before changing anything; locks are taken along the references,
+    // as loadDependency() does, so this doesn't deadlock with other threads
+    vector<pair<const string*, Model*>> closure { { &key, &model } };
+    vector<ModelRegistry::lock_type> locks;
+    unordered_set<string> visitedKeys;
+    for (size_t i = 0; i < closure.size(); ++i) {
+        if (closure[i].second->roleSensitive)
+            return false;
+        for (const auto& depKey: closure[i].second->dependencies) {
+            if (!visitedKeys.insert(depKey).second)
+                continue;
+            if (_modelsInProgress.contains(depKey))
+                return false; // Locked by this thread, and not complete yet
+            auto [depModel, depLock, unseen] = _allModels->lock(depKey);
+            closure.emplace_back(&depKey, &depModel);
+            locks.push_back(move(depLock));
+        }
+    }
+    // Other than in the schema roles, the analysis of data models doesn't
+    // depend on the role (unless the model is roleSensitive), so this is
+    // what re-analyzing the models for all roles would come to
+    for (auto [mKey, m]: closure)
+        for (auto& schema: m->types)
+            if (schema.role != InAndOut) {
+                schema.role = InAndOut;
+                _allModels->markUpdated(*mKey);
+            }
+    return true;
 }
 
 void Analyzer::fillDataModel(Model& m, const YamlNode& yaml,
@@ -18,32 +18,197 @@
 
 #pragma once
 
+#include "depgraph.h"
 #include "translator.h"
 #include "model.h"
 #include "util.h"
 
 #include <stack>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <optional>
+#include <thread>
 
 class YamlNode;
 class YamlMap;
 class YamlSequence;
+class YamlDocumentCache;
+class ModelSnapshot;
+
+/// \brief Thread-safe storage of all models loaded during the run
+///
+/// A model is only filled by the thread holding the lock returned from
+/// lock(); other threads asking for the same key wait until that thread
+/// is done with the model, so that each model is only loaded once.
+/// The registry knows which thread holds each model and which model each
+/// thread waits for, so that a circular reference split across threads
+/// is reported instead of making the threads wait for each other forever.
+class ModelRegistry
+{
+public:
+    using models_t = std::unordered_map<std::string, Model>;
+
+    /// The lock on a model in the registry, see lock()
+    class Lock {
+    public:
+        Lock() = default;
+        Lock(Lock&& other) noexcept;
+        Lock& operator=(Lock&& other) noexcept;
+        ~Lock() { unlock(); }
+
+        void unlock();
+
+    private:
+        friend class ModelRegistry;
+        Lock(ModelRegistry* registry, const std::string* key,
+             std::unique_lock<std::mutex> lock);
+
+        ModelRegistry* _registry = nullptr;
+        const std::string* _key = nullptr;
+        std::unique_lock<std::mutex> _lock;
+    };
+    using lock_type = Lock;
+
+    struct LockedModel {
+        Model& model;
+        lock_type lock;
+        bool unseen; ///< The model has been created by this call
+    };
+
+    /// \brief Get the model for \p key, waiting until no other thread uses it
+    ///
+    /// \throw Exception if the thread holding the model waits, directly
+    ///        or through other threads, for a model this thread holds
+    [[nodiscard]] LockedModel lock(const std::string& key);
+    /// Not synchronised - only use when no analysis is in progress
+    [[nodiscard]] const models_t& models() const { return _models; }
+    /// Forget all models; only use when no analysis is in progress
+    void clear();
+    /// Forget one model; only use when no analysis is in progress
+    void erase(const std::string& key);
+    /// Note that the model with \p key changed after it had been loaded
+    void markUpdated(const std::string& key);
+    /// \brief Get (and forget) the keys passed to markUpdated() so far
+    ///
+    /// Only use when no analysis is in progress.
+    [[nodiscard]] std::set<std::string> takeUpdated();
+
+private:
+    std::mutex _mutex;
+    models_t _models;
+    std::set<std::string> _updatedKeys;
+    std::unordered_map<std::string, std::mutex> _modelLocks;
+    /// The threads holding the locks on models, by the model key
+    std::unordered_map<std::string, std::thread::id> _owners;
+    /// The keys of models that threads wait for, by the thread
+    std::unordered_map<std::thread::id, std::string> _awaitedKeys;
+};
 
 class Analyzer
 {
 public:
     using string = std::string;
     using fspath = std::filesystem::path;
-    using models_t = std::unordered_map<string, Model>;
+    using models_t = ModelRegistry::models_t;
 
     explicit Analyzer(const Translator& translator, fspath basePath = {});
 
     const Model& loadModel(const string& filePath, InOut inOut);
-    static const models_t& allModels() { return _allModels; }
+    /// \brief Find the files \p filePath refers to with `$ref`
+    ///
+    /// Only parses the file (the analysis reuses the parsed document later);
+    /// references in examples and those mapped to types in the configuration
+    /// are skipped. A file that cannot be parsed is taken as referring to
+    /// nothing, leaving the error to the analysis.
+    /// \return the paths in the form loadDependency() makes them, so that
+    ///         makeModelKey() gives the keys of the models to be loaded
+    [[nodiscard]] std::vector<string>
+    scanReferences(const string& filePath) const;
+    /// \brief Load a data schema before anything refers to it
+    ///
+    /// This allows analyzing schemas in parallel, dependencies first; the
+    /// first loadDependency() for the model then finishes it as if it were
+    /// loaded by that call. A failure is not reported: the model is loaded
+    /// again when referred to, to report errors in the right context.
+    void preloadDependency(const string& filePath);
+    /// \brief Forget the preloaded models that nothing has referred to
+    ///
+    /// Only use when no analysis is in progress.
+    static void dropUnusedPreloads();
+    static const models_t& allModels() { return _allModels->models(); }
+    /// \brief Store the models loaded from now on in \p registry
+    ///
+    /// Models analyzed with different configurations (or output directories)
+    /// are not interchangeable, so each configuration needs a registry of its
+    /// own. Only use when no analysis is in progress; \p registry must
+    /// outlive its use by Analyzer.
+    static void useRegistry(ModelRegistry& registry)
+    {
+        _allModels = &registry;
+    }
+    /// \brief Get the keys of the models changed after they had been loaded
+    ///
+    /// A data model loaded before (in --watch mode, by a previous pass) can
+    /// be extended to more roles, or reloaded for them, when a newly analyzed
+    /// model refers to it; its files have to be emitted again then. The keys
+    /// are forgotten once returned. Only use when no analysis is in progress.
+    [[nodiscard]] static std::set<string> takeUpdatedModels()
+    {
+        return _allModels->takeUpdated();
+    }
+    /// \brief Forget all models loaded so far, to start analysis anew
+    ///
+    /// Only use when no analysis is in progress; references to the models
+    /// obtained before become invalid.
+    static void clearAllModels() { _allModels->clear(); }
+    /// \brief Find the models that have to be reloaded after files change
+    ///
+    /// \return the keys in allModels() for the models loaded from
+    ///         \p changedFiles along with all models that refer to them,
+    ///         directly or not
+    [[nodiscard]] static std::set<string>
+    dependentModels(const std::set<fspath>& changedFiles);
+    /// \brief Forget the models with \p keys
+    ///
+    /// The models will be loaded anew the next time they are referred to.
+    /// Only use when no analysis is in progress.
+    static void forgetModels(const std::set<string>& keys);
+    /// \brief Get the graph of references between the models loaded so far
+    ///
+    /// Only use when no analysis is in progress.
+    [[nodiscard]] static DependencyGraph dependencyGraph()
+    {
+        return DependencyGraph(allModels());
+    }
+    /// \brief Restore the models with \p keys from \p snapshot
+    ///
+    /// Models that are not up to date in the snapshot are left to
+    /// the analysis; the models they refer to are still restored if they are
+    /// up to date. Only use when no analysis is in progress.
+    /// \return the keys of the restored models
+    static std::set<string> restoreModels(ModelSnapshot& snapshot,
+                                          const std::set<string>& keys,
+                                          const Translator& translator);
+    /// \brief Load the models with keys in \p roles for at least those roles
+    ///
+    /// Models that are not analyzed again (e.g. skipped with --incremental)
+    /// may need a data model for a broader role than the models analyzed
+    /// in this run do. Only use when no analysis is in progress.
+    static void requireRoles(std::map<string, InOut> roles)
+    {
+        _requiredRoles = std::move(roles);
+    }
+    /// Forget all parsed files, e.g. when the configuration is reloaded
+    static void clearDocumentCache();
+    /// The key in allModels() for the model loaded from \p filePath
+    [[nodiscard]] static string makeModelKey(const string& filePath);
 
 private:
-    static models_t _allModels;
+    static ModelRegistry* _allModels;
+    static std::map<string, InOut> _requiredRoles;
+    /// Files are parsed once even if their models are analyzed several times
+    static YamlDocumentCache _documents;
 
     const fspath _baseDir;
     const Translator& _translator;
@@ -55,6 +220,8 @@ private:
     };
     const Context* _context = nullptr;
     size_t _indent = 0;
+    /// Keys of models being loaded by this analyzer, to detect circular refs
+    std::unordered_set<string> _modelsInProgress;
     friend class ContextOverlay; // defined in analyzer.cpp
 
     enum IsTopLevel : bool { Inner = false, TopLevel = true };
@@ -72,10 +239,31 @@ private:
     [[nodiscard]] InOut currentRole() const { return currentScope().role; }
     [[nodiscard]] const Call* currentCall() const { return currentScope().call; }
 
-    [[nodiscard]] std::pair<const Model&, fspath>
-    loadDependency(const string& relPath, const string& overrideTitle,
-                   bool inlined = false);
+    struct Dependency {
+        const Model& model;
+        fspath importPath;
+        /// Keeps other threads from changing the model while it's in use
+        ModelRegistry::lock_type lock;
+    };
+    [[nodiscard]] Dependency loadDependency(const string& relPath,
+                                            const string& overrideTitle,
+                                            bool inlined = false);
+    [[nodiscard]] Dependency finishDependency(Model& model, bool unseen,
+                                              const string& overrideTitle,
+                                              bool inlined, fspath importPath,
+                                              ModelRegistry::lock_type lock);
+    /// \brief Extend the data model, along with its dependencies, to all roles
+    /// \return false if the model has to be re-analyzed for that instead
+    bool widenRoles(const string& key, Model& model);
     void fillDataModel(Model& m, const YamlNode& yaml, const fspath &filename);
+    /// \p role widened as requireRoles() asks for the model with \p key
+    [[nodiscard]] static InOut withRequiredRole(const string& key, InOut role);
+    /// \brief Analyze the data schema at \p filePath into \p model
+    ///
+    /// Both loadDependency() and preloadDependency() use this, so that
+    /// a model comes out the same regardless of which of them loads it.
+    void analyzeDataModel(Model& model, const fspath& filePath,
+                          const string& key, InOut role);
 
     [[nodiscard]] TypeUsage analyzeTypeUsage(const YamlMap& node,
                                              IsTopLevel isTopLevel = Inner);
@@ -0,0 +1,492 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Benchmarks for the stages of the generator pipeline, run over a synthetic
+// corpus of API descriptions and data schemas generated on the fly.
+// Run with --help for the options; results are printed as JSON.
+
+#include "analyzer.h"
+#include "printer.h"
+#include "translator.h"
+#include "yaml.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <numeric>
+#include <optional>
+#include <sstream>
+
+using namespace std;
+namespace fs = filesystem;
+
+/// Allocations made with the global operator new, in all threads
+atomic<size_t> heapAllocations = 0;
+
+void* operator new(size_t size)
+{
+    ++heapAllocations;
+    if (auto* p = malloc(size > 0 ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct CorpusParams {
+    unsigned apiFiles = 20; ///< Swagger files, 4 operations each
+    unsigned schemaFiles = 50; ///< JSON Schema files referred to from APIs
+    unsigned properties = 8; ///< Scalar properties in each schema
+    unsigned depth = 5; ///< Length of $ref chains between schemas
+    unsigned width = 3; ///< Number of $refs in allOf of each schema
+};
+
+/// Access to Printer internals for the renderType() benchmark
+struct PrinterBenchmark {
+    static const Printer::m_object_type& renderType(const Printer& printer,
+                                                    const TypeUsage& tu)
+    {
+        return printer.renderType(tu);
+    }
+};
+
+string schemaFileName(unsigned i) { return "def" + to_string(i) + ".yaml"; }
+string apiFileName(unsigned j) { return "api" + to_string(j) + ".yaml"; }
+
+void writeFile(const fs::path& fPath, const string& contents)
+{
+    ofstream ofs { fPath };
+    if (!ofs.good())
+        throw Exception(fPath.string() + ": Couldn't open for writing");
+    ofs << contents;
+}
+
+void writeConfig(const fs::path& fPath)
+{
+    writeFile(fPath, R"(analyzer:
+  subst:
+    "%CLIENT_RELEASE_LABEL%": r0
+  identifiers:
+    type: ofType
+    /^p(\d+)$/: prop$1
+  types:
+  - integer:
+    - int64: { type: qint64, imports: <QtCore/QtGlobal> }
+    - //: int
+  - number: double
+  - boolean: bool
+  - string:
+    - date-time: { type: QDateTime, imports: <QtCore/QDateTime> }
+    - //: QString
+  - array: { type: "QVector<{{1}}>", imports: <QtCore/QVector> }
+  - map: { type: "QHash<QString, {{1}}>", imports: <QtCore/QHash> }
+  - object: { type: QJsonObject, imports: <QtCore/QJsonObject> }
+  - variant: { type: QVariant, imports: <QtCore/QVariant> }
+  - $ref:
+    - //:
+        _importRenderer: '"{{#segments}}{{_}}{{#_join}}/{{/_join}}{{/segments}}.h"'
+mustache:
+  templates:
+    data:
+      .h: |
+        {{#imports}}#include {{_}}
+        {{/imports}}
+        {{#models}}{{#model}}
+        /// {{#description}}{{_}}{{/description}}
+        struct {{name}}{{#parents?}} : {{#parents}}{{name}}{{#_join}}, {{/_join}}{{/parents}}{{/parents?}} {
+        {{#vars}}    {{#dataType}}{{qualifiedName}}{{/dataType}} {{nameCamelCase}};
+        {{/vars}}};
+        {{/model}}{{/models}}
+    api:
+      .h: |
+        {{#imports}}#include {{_}}
+        {{/imports}}
+        {{#operations}}{{#operation}}
+        /// {{summary}}
+        class {{camelCaseOperationId}}Job {
+        {{#models}}{{#model}}    struct {{name}} { {{#vars}}{{#dataType}}{{name}}{{/dataType}} {{nameCamelCase}}; {{/vars}}};
+        {{/model}}{{/models}}{{#allParams}}    {{#dataType}}{{qualifiedName}}{{/dataType}} {{paramName}};
+        {{/allParams}}{{#responses}}{{#normalResponse?}}{{#allProperties}}    {{#dataType}}{{name}}{{/dataType}} {{paramName}}() const;
+        {{/allProperties}}{{/normalResponse?}}{{/responses}}};
+        {{/operation}}{{/operations}}
+)");
+}
+
+/// \brief Make a JSON Schema file for schema #i
+///
+/// Schemas only refer to schemas with higher numbers so that there are
+/// no cycles; `next` makes chains of `depth` schemas while allOf refers to
+/// `width` schemas in the following chains.
+string makeSchema(unsigned i, const CorpusParams& params)
+{
+    ostringstream os;
+    os << "type: object\ntitle: Def" << i << "\ndescription: Definition " << i
+       << "\nallOf:\n";
+    for (unsigned w = 1; w <= params.width; ++w)
+        if (const auto target = i + w * params.depth;
+            target < params.schemaFiles)
+            os << "- $ref: " << schemaFileName(target) << '\n';
+    os << "- type: object\n  properties:\n";
+    static const char* const scalarTypes[] = {
+        "{ type: string }", "{ type: integer }",
+        "{ type: integer, format: int64 }", "{ type: number }",
+        "{ type: boolean }", "{ type: string, format: date-time }",
+        "{ type: array, items: { type: string } }",
+        "{ type: object, additionalProperties: { type: integer } }"
+    };
+    for (unsigned p = 0; p < params.properties; ++p)
+        os << "    p" << p << ": "
+           << scalarTypes[(i + p) % size(scalarTypes)] << '\n';
+    os << "    type: { type: string, description: A renamed identifier }\n";
+    if ((i + 1) % params.depth != 0 && i + 1 < params.schemaFiles)
+        os << "    next: { $ref: " << schemaFileName(i + 1) << " }\n";
+    return os.str();
+}
+
+string makeApi(unsigned j, const CorpusParams& params)
+{
+    ostringstream os;
+    os << "swagger: '2.0'\ninfo: { title: API " << j
+       << ", version: '1.0' }\nhost: example.org\n"
+          "basePath: /_api/client/%CLIENT_RELEASE_LABEL%\n"
+          "consumes: [ application/json ]\nproduces: [ application/json ]\n"
+          "paths:\n";
+    const auto schemaRef = [&params](unsigned n) {
+        return schemaFileName(n % max(params.schemaFiles, 1u));
+    };
+    for (unsigned k = 0; k < 4; ++k) {
+        const auto op = "op" + to_string(j) + "n" + to_string(k);
+        os << "  /" << op << "/{id}:\n    post:\n      operationId: " << op
+           << "\n      summary: Operation " << k << " of API " << j << R"(
+      parameters:
+      - { in: path, name: id, type: string, required: true }
+      - { in: query, name: limit, type: integer }
+      - in: body
+        name: body
+        schema:
+          type: object
+          properties:
+            item: { $ref: )" << schemaRef(j * 7 + k) << R"( }
+            items: { type: array, items: { $ref: )" << schemaRef(j * 3 + k)
+           << R"( } }
+            extra: { type: object, additionalProperties: { type: string } }
+      responses:
+        '200':
+          description: OK
+          schema:
+            type: object
+            properties:
+              result: { $ref: )" << schemaRef(j * 5 + k) << R"( }
+              count: { type: integer }
+)";
+    }
+    return os.str();
+}
+
+void makeCorpus(const fs::path& dir, const CorpusParams& params)
+{
+    fs::create_directories(dir);
+    writeConfig(dir / "gtad.yaml");
+    for (unsigned i = 0; i < params.schemaFiles; ++i)
+        writeFile(dir / schemaFileName(i), makeSchema(i, params));
+    for (unsigned j = 0; j < params.apiFiles; ++j)
+        writeFile(dir / apiFileName(j), makeApi(j, params));
+}
+
+struct StageResult {
+    string name;
+    size_t operations = 0; ///< Per iteration
+    vector<double> samplesMs;
+    /// Per iteration, as counted by operator new
+    vector<size_t> heapAllocations;
+};
+
+/// \brief Run \p fn \p iterations times, each after \p setup
+///
+/// \p setup is neither timed nor counted; it lets stages start each iteration
+/// with the caches cleared. \p fn returns the number of operations made.
+template <typename SetupFnT, typename FnT>
+StageResult measure(string name, unsigned iterations, const SetupFnT& setup,
+                    const FnT& fn)
+{
+    StageResult result { move(name), 0, {}, {} };
+    for (unsigned i = 0; i < iterations; ++i) {
+        setup();
+        const size_t heapBefore = heapAllocations;
+        const auto start = chrono::steady_clock::now();
+        result.operations = fn();
+        result.samplesMs.push_back(chrono::duration<double, milli>(
+                                       chrono::steady_clock::now() - start)
+                                       .count());
+        result.heapAllocations.push_back(heapAllocations - heapBefore);
+    }
+    clog << result.name << ": done" << endl;
+    return result;
+}
+
+template <typename FnT>
+StageResult measure(string name, unsigned iterations, const FnT& fn)
+{
+    return measure(move(name), iterations, [] {}, fn);
+}
+
+void writeResults(ostream& os, const CorpusParams& params,
+                  const vector<StageResult>& results)
+{
+    os << "{\n  \"corpus\": { \"apiFiles\": " << params.apiFiles
+       << ", \"schemaFiles\": " << params.schemaFiles
+       << ", \"properties\": " << params.properties
+       << ", \"depth\": " << params.depth << ", \"width\": " << params.width
+       << " },\n  \"stages\": [";
+    const char* separator = "\n";
+    const auto median = [](vector<size_t> counts) {
+        sort(counts.begin(), counts.end());
+        return counts[counts.size() / 2];
+    };
+    for (const auto& r: results) {
+        auto samples = r.samplesMs;
+        sort(samples.begin(), samples.end());
+        const auto mean =
+            accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+        os << separator << "    { \"name\": " << toJsonString(r.name)
+           << ", \"iterations\": " << samples.size()
+           << ", \"operations\": " << r.operations
+           << ", \"minMs\": " << samples.front()
+           << ", \"medianMs\": " << samples[samples.size() / 2]
+           << ", \"meanMs\": " << mean << ", \"maxMs\": " << samples.back()
+           << ", \"heapAllocations\": " << median(r.heapAllocations) << " }";
+        separator = ",\n";
+    }
+    os << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    CorpusParams params;
+    unsigned iterations = 5;
+    fs::path workDir = fs::temp_directory_path() / "gtad_bench";
+    string jsonPath;
+    bool keep = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const string_view arg { argv[i] };
+            const auto nextValue = [&]() -> string {
+                if (++i == argc)
+                    throw Exception("Missing value for " + string(arg));
+                return argv[i];
+            };
+            const auto nextNumber = [&]() -> unsigned {
+                const auto value = nextValue();
+                const auto n = stoul(value);
+                if (n == 0)
+                    throw Exception("Invalid value for " + string(arg) + ": "
+                                    + value);
+                return unsigned(n);
+            };
+            if (arg == "--apis")
+                params.apiFiles = nextNumber();
+            else if (arg == "--schemas")
+                params.schemaFiles = nextNumber();
+            else if (arg == "--properties")
+                params.properties = nextNumber();
+            else if (arg == "--depth")
+                params.depth = nextNumber();
+            else if (arg == "--width")
+                params.width = nextNumber();
+            else if (arg == "--iterations")
+                iterations = nextNumber();
+            else if (arg == "--workdir")
+                workDir = nextValue();
+            else if (arg == "--json")
+                jsonPath = nextValue();
+            else if (arg == "--keep")
+                keep = true;
+            else {
+                cout << "Usage: " << argv[0]
+                     << " [--apis N] [--schemas N] [--properties N]"
+                        " [--depth N] [--width N] [--iterations N]"
+                        " [--workdir DIR] [--json FILE] [--keep]\n";
+                return arg == "--help" ? 0 : 1;
+            }
+        }
+
+        const auto corpusDir = workDir / "corpus";
+        const auto outputDir = workDir / "out";
+        fs::remove_all(workDir);
+        makeCorpus(corpusDir, params);
+        fs::create_directories(outputDir);
+
+        // Keep the analyzer and printer messages out of timings
+        Log::setVerbosity(Verbosity::Quiet);
+        vector<StageResult> results;
+
+        const Translator translator { corpusDir / "gtad.yaml", outputDir,
+                                      Verbosity::Quiet };
+
+        vector<fs::path> allFiles;
+        for (unsigned i = 0; i < params.schemaFiles; ++i)
+            allFiles.push_back(corpusDir / schemaFileName(i));
+        for (unsigned j = 0; j < params.apiFiles; ++j)
+            allFiles.push_back(corpusDir / apiFileName(j));
+        results.push_back(measure("yamlLoad", iterations, [&] {
+            for (const auto& f: allFiles)
+                (void)YamlMap::loadFromFile(f, translator.substitutions());
+            return allFiles.size();
+        }));
+
+        // Stages that have caches are measured "cold", with the caches
+        // cleared before each iteration, and "warm", on the caches filled by
+        // the previous iterations, i.e. only measuring the cache lookups
+        const auto analyze = [&] {
+            Analyzer analyzer { translator, corpusDir };
+            for (unsigned j = 0; j < params.apiFiles; ++j)
+                analyzer.loadModel(apiFileName(j), InAndOut);
+            return size_t(params.apiFiles);
+        };
+        results.push_back(measure(
+            "analyze", iterations,
+            [] {
+                Analyzer::clearAllModels();
+                Analyzer::clearDocumentCache();
+            },
+            analyze));
+        results.push_back(measure("analyzeWarm", iterations,
+                                  [] { Analyzer::clearAllModels(); }, analyze));
+
+        // A fresh translator (and printer) has empty caches
+        optional<Translator> freshTranslator;
+        const auto makeFreshTranslator = [&] {
+            freshTranslator.reset();
+            freshTranslator.emplace(corpusDir / "gtad.yaml", outputDir,
+                                    Verbosity::Quiet);
+        };
+        const Translator* currentTranslator = &translator;
+
+        // Each query is made once per iteration, so that a cold iteration
+        // only has cache misses
+        static const pair<string, string> typeQueries[] = {
+            { "integer", "" }, { "integer", "int64" }, { "string", "" },
+            { "string", "date-time" }, { "number", "float" },
+            { "array", "string" }, { "map", "string->int" },
+            { "object", "" }
+        };
+        vector<pair<string, string>> allTypeQueries { begin(typeQueries),
+                                                      end(typeQueries) };
+        vector<Identifier> scopes;
+        for (unsigned i = 0; i < params.schemaFiles; ++i) {
+            allTypeQueries.emplace_back("$ref", schemaFileName(i));
+            allTypeQueries.emplace_back("schema", "Def" + to_string(i));
+            scopes.push_back({ "Def" + to_string(i) });
+        }
+        vector<string> identifiers { "type", "next", "limit" };
+        for (unsigned p = 0; p < params.properties; ++p)
+            identifiers.push_back("p" + to_string(p));
+        const auto mapTypesAndIdentifiers = [&] {
+            for (const auto& [type, format]: allTypeQueries)
+                (void)currentTranslator->mapType(type, format);
+            for (const auto& scope: scopes)
+                for (const auto& id: identifiers)
+                    (void)currentTranslator->mapIdentifier(id, &scope, false);
+            return allTypeQueries.size() + scopes.size() * identifiers.size();
+        };
+        results.push_back(measure(
+            "mapTypeAndIdentifier", iterations,
+            [&] {
+                makeFreshTranslator();
+                currentTranslator = &*freshTranslator;
+            },
+            mapTypesAndIdentifiers));
+        currentTranslator = &translator;
+        (void)mapTypesAndIdentifiers(); // Fill the caches
+        results.push_back(measure("mapTypeAndIdentifierWarm", iterations,
+                                  mapTypesAndIdentifiers));
+
+        vector<const TypeUsage*> typeUsages;
+        for (const auto& [key, model]: Analyzer::allModels()) {
+            for (const auto& schema: model.types)
+                for (const auto& f: schema.fields)
+                    typeUsages.push_back(&f.type);
+            for (const auto& callClass: model.callClasses)
+                for (const auto& call: callClass.calls)
+                    for (const auto& paramsBlock: call.params)
+                        for (const auto& p: paramsBlock)
+                            typeUsages.push_back(&p.type);
+        }
+        const auto renderTypes = [&] {
+            const auto& printer = currentTranslator->printer();
+            for (const auto* tu: typeUsages)
+                (void)PrinterBenchmark::renderType(printer, *tu);
+            return typeUsages.size();
+        };
+        results.push_back(measure(
+            "renderType", iterations,
+            [&] {
+                makeFreshTranslator();
+                currentTranslator = &*freshTranslator;
+            },
+            renderTypes));
+        currentTranslator = &translator;
+        (void)renderTypes();
+        results.push_back(
+            measure("renderTypeWarm", iterations, renderTypes));
+
+        for (const auto& [key, model]: Analyzer::allModels())
+            fs::create_directories(
+                (outputDir / key).parent_path().lexically_normal());
+        const auto print = [&] {
+            const auto& printer = currentTranslator->printer();
+            size_t filesCount = 0;
+            for (const auto& [key, model]: Analyzer::allModels())
+                if (!model.empty() && !model.trivial())
+                    filesCount += printer.print(key, model).size();
+            return filesCount;
+        };
+        results.push_back(measure(
+            "print", iterations,
+            [&] {
+                makeFreshTranslator();
+                currentTranslator = &*freshTranslator;
+            },
+            print));
+        currentTranslator = &translator;
+        (void)print();
+        results.push_back(measure("printWarm", iterations, print));
+
+        if (!jsonPath.empty()) {
+            ofstream ofs { jsonPath };
+            if (!ofs.good())
+                throw Exception(jsonPath + ": Couldn't open for writing");
+            writeResults(ofs, params, results);
+        } else
+            writeResults(cout, params, results);
+        if (!keep)
+            fs::remove_all(workDir);
+    } catch (Exception& e) {
+        cerr << e.message << endl;
+        return 3;
+    } catch (exception& e) {
+        cerr << e.what() << endl;
+        return 3;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "depgraph.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+using namespace std;
+
+DependencyGraph::DependencyGraph(const models_t& models)
+{
+    for (const auto& [key, model]: models) {
+        _keys.insert(key);
+        for (const auto& depKey: model.dependencies) {
+            _keys.insert(depKey);
+            _dependencies[key].insert(depKey);
+            _dependents[depKey].insert(key);
+        }
+    }
+}
+
+DependencyGraph::DependencyGraph(const edges_t& dependencies)
+    : _dependencies(dependencies)
+{
+    for (const auto& [key, depKeys]: dependencies) {
+        _keys.insert(key);
+        for (const auto& depKey: depKeys) {
+            _keys.insert(depKey);
+            _dependents[depKey].insert(key);
+        }
+    }
+}
+
+const DependencyGraph::keys_t& findKeys(const DependencyGraph::edges_t& edges,
+                                        const string& key)
+{
+    static const DependencyGraph::keys_t noKeys;
+    const auto it = edges.find(key);
+    return it != edges.end() ? it->second : noKeys;
+}
+
+const DependencyGraph::keys_t&
+DependencyGraph::dependencies(const string& key) const
+{
+    return findKeys(_dependencies, key);
+}
+
+const DependencyGraph::keys_t&
+DependencyGraph::dependents(const string& key) const
+{
+    return findKeys(_dependents, key);
+}
+
+DependencyGraph::keys_t DependencyGraph::closure(const keys_t& keys,
+                                                const edges_t& edges)
+{
+    keys_t result = keys;
+    vector<string> keysToVisit { keys.begin(), keys.end() };
+    while (!keysToVisit.empty()) {
+        const auto key = move(keysToVisit.back());
+        keysToVisit.pop_back();
+        for (const auto& nextKey: findKeys(edges, key))
+            if (result.insert(nextKey).second)
+                keysToVisit.push_back(nextKey);
+    }
+    return result;
+}
+
+DependencyGraph::keys_t DependencyGraph::withDependents(const keys_t& keys) const
+{
+    return closure(keys, _dependents);
+}
+
+DependencyGraph::keys_t
+DependencyGraph::withDependencies(const keys_t& keys) const
+{
+    return closure(keys, _dependencies);
+}
+
+vector<vector<string>> DependencyGraph::waves() const
+{
+    // Kahn's algorithm, taking all models that became ready at once
+    map<string, size_t> pendingDependencies;
+    vector<string> wave;
+    for (const auto& key: _keys)
+        if (const auto n = dependencies(key).size(); n > 0)
+            pendingDependencies.emplace(key, n);
+        else
+            wave.push_back(key);
+
+    vector<vector<string>> result;
+    while (!wave.empty()) {
+        vector<string> nextWave;
+        for (const auto& key: wave)
+            for (const auto& dependent: dependents(key))
+                if (--pendingDependencies[dependent] == 0) {
+                    pendingDependencies.erase(dependent);
+                    nextWave.push_back(dependent);
+                }
+        result.push_back(move(wave));
+        wave = move(nextWave);
+    }
+    if (!pendingDependencies.empty()) {
+        auto& lastWave = result.emplace_back();
+        for (const auto& p: pendingDependencies)
+            lastWave.push_back(p.first);
+    }
+    return result;
+}
+
+void DependencyGraph::forEachInOrder(
+    unsigned jobs, const function<void(const string&)>& fn) const
+{
+    map<string, size_t> pendingDependencies;
+    deque<string> readyKeys;
+    for (const auto& key: _keys)
+        if (const auto n = dependencies(key).size(); n > 0)
+            pendingDependencies.emplace(key, n);
+        else
+            readyKeys.push_back(key);
+
+    mutex m;
+    condition_variable keysChanged;
+    size_t keysInProgress = 0;
+    exception_ptr eptr;
+    auto worker = [&] {
+        unique_lock l(m);
+        for (;;) {
+            keysChanged.wait(l, [&] {
+                return !readyKeys.empty() || keysInProgress == 0 || eptr;
+            });
+            if (eptr || readyKeys.empty()) // Failed, or nothing more to do
+                return;
+            const auto key = move(readyKeys.front());
+            readyKeys.pop_front();
+            ++keysInProgress;
+            l.unlock();
+            try {
+                fn(key);
+            } catch (...) {
+                l.lock();
+                if (!eptr)
+                    eptr = current_exception();
+                --keysInProgress;
+                keysChanged.notify_all();
+                return;
+            }
+            l.lock();
+            --keysInProgress;
+            for (const auto& dependent: dependents(key))
+                if (const auto it = pendingDependencies.find(dependent);
+                    it != pendingDependencies.end() && --it->second == 0) {
+                    pendingDependencies.erase(it);
+                    readyKeys.push_back(dependent);
+                }
+            keysChanged.notify_all();
+        }
+    };
+    const auto threadsCount =
+        min<size_t>(max(jobs, 1U), max<size_t>(_keys.size(), 1)) - 1;
+    vector<thread> threads;
+    threads.reserve(threadsCount);
+    while (threads.size() < threadsCount)
+        threads.emplace_back(worker);
+    worker(); // The calling thread is one of the workers
+    for (auto& t: threads)
+        t.join();
+    if (eptr)
+        rethrow_exception(eptr);
+    for (const auto& p: pendingDependencies)
+        fn(p.first);
+}
+
+void DependencyGraph::writeDot(ostream& os) const
+{
+    os << "digraph dependencies {\n";
+    for (const auto& key: _keys) {
+        os << "  " << toJsonString(key) << ";\n";
+        for (const auto& depKey: dependencies(key))
+            os << "  " << toJsonString(key) << " -> " << toJsonString(depKey)
+               << ";\n";
+    }
+    os << "}\n";
+}
+
+void DependencyGraph::writeJson(ostream& os) const
+{
+    os << '{';
+    const char* separator = "\n";
+    for (const auto& key: _keys) {
+        os << separator << "  " << toJsonString(key) << ": [";
+        const char* depSeparator = "";
+        for (const auto& depKey: dependencies(key)) {
+            os << depSeparator << toJsonString(depKey);
+            depSeparator = ", ";
+        }
+        os << ']';
+        separator = ",\n";
+    }
+    os << "\n}\n";
+}
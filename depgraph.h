@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "model.h"
+
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <unordered_map>
+
+/// \brief Which models refer to which, by their keys in Analyzer::allModels()
+///
+/// Edges come from Model::dependencies, which the analyzer fills as it
+/// resolves `$ref`s to other files; the graph adds the reverse edges and
+/// queries over both directions. The graph is a snapshot: it doesn't change
+/// when more models are loaded.
+class DependencyGraph
+{
+public:
+    using string = std::string;
+    using keys_t = std::set<string>;
+    using models_t = std::unordered_map<string, Model>;
+    using edges_t = std::map<string, keys_t>;
+
+    explicit DependencyGraph(const models_t& models);
+    /// Make the graph from the keys each key depends on
+    explicit DependencyGraph(const edges_t& dependencies);
+
+    [[nodiscard]] const keys_t& keys() const { return _keys; }
+    /// Models \p key refers to directly
+    [[nodiscard]] const keys_t& dependencies(const string& key) const;
+    /// Models that refer to \p key directly
+    [[nodiscard]] const keys_t& dependents(const string& key) const;
+    /// \p keys along with all models that refer to them, directly or not
+    [[nodiscard]] keys_t withDependents(const keys_t& keys) const;
+    /// \p keys along with all models they refer to, directly or not
+    [[nodiscard]] keys_t withDependencies(const keys_t& keys) const;
+    /// \brief Split the models into waves, each referring only to earlier ones
+    ///
+    /// Models in one wave don't depend on each other and can be processed
+    /// in parallel once the previous waves are done. Models in a cycle
+    /// (the analyzer doesn't allow those) end up together in the last wave.
+    [[nodiscard]] std::vector<std::vector<string>> waves() const;
+    /// \brief Invoke \p fn on each key once \p fn is done with its dependencies
+    ///
+    /// Uses up to \p jobs threads, each picking the next key as soon as
+    /// all dependencies of the key are processed, without waiting for other
+    /// keys from the same wave. Keys in a cycle are processed one by one
+    /// after everything else. Once \p fn throws, no more keys are picked up
+    /// and the exception is rethrown after all threads are done.
+    void forEachInOrder(unsigned jobs,
+                        const std::function<void(const string&)>& fn) const;
+
+    /// Write the graph in Graphviz format, edges pointing to dependencies
+    void writeDot(std::ostream& os) const;
+    /// Write the graph as a JSON object with dependencies of each model
+    void writeJson(std::ostream& os) const;
+
+private:
+    keys_t _keys;
+    edges_t _dependencies;
+    edges_t _dependents;
+
+    static keys_t closure(const keys_t& keys, const edges_t& edges);
+};
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "logger.h"
+
+#include <iostream>
+#include <mutex>
+#include <string>
+
+using namespace std;
+
+atomic<Verbosity> Log::_verbosity = Verbosity::Basic;
+
+/// The buffer for the standard output, written out when it gets big enough
+struct OutputBuffer {
+    static constexpr size_t FlushThreshold = 16 * 1024;
+
+    mutex m;
+    string buffer;
+
+    void flushUnlocked()
+    {
+        cout.write(buffer.data(), streamsize(buffer.size()));
+        cout.flush();
+        buffer.clear();
+    }
+    ~OutputBuffer() { flushUnlocked(); }
+};
+
+static OutputBuffer& outputBuffer()
+{
+    static OutputBuffer instance;
+    return instance;
+}
+
+void Log::flush()
+{
+    auto& out = outputBuffer();
+    const lock_guard l(out.m);
+    out.flushUnlocked();
+}
+
+Log::Line::~Line()
+{
+    _os << '\n';
+    auto& out = outputBuffer();
+    const lock_guard l(out.m);
+    if (_level == Verbosity::Quiet) {
+        out.flushUnlocked();
+        clog << _os.view() << std::flush;
+        return;
+    }
+    out.buffer += _os.view();
+    if (out.buffer.size() >= OutputBuffer::FlushThreshold)
+        out.flushUnlocked();
+}
@@ -0,0 +1,83 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <atomic>
+#include <sstream>
+
+enum class Verbosity { Quiet = 0, Basic, Debug };
+
+/// \brief Messages of the generator, filtered by verbosity
+///
+/// Use the GTAD_DEBUG, GTAD_INFO and GTAD_WARNING macros rather than
+/// the class directly: they don't even evaluate the message if its level is
+/// above the current verbosity. Informational and debug messages go to
+/// the standard output through a buffer shared by all threads; warnings go
+/// to the standard error right away (after everything buffered before them).
+/// Each message is written as a whole, so messages from different threads
+/// don't get mixed up.
+class Log {
+public:
+    static void setVerbosity(Verbosity verbosity)
+    {
+        _verbosity.store(verbosity, std::memory_order_relaxed);
+    }
+    [[nodiscard]] static bool enabled(Verbosity level)
+    {
+        return level <= _verbosity.load(std::memory_order_relaxed);
+    }
+    /// Write out everything buffered so far
+    static void flush();
+
+    /// A single message, passed on to the output when destroyed
+    class Line {
+    public:
+        explicit Line(Verbosity level) : _level(level) {}
+        ~Line();
+        Line(const Line&) = delete;
+        Line& operator=(const Line&) = delete;
+
+        template <typename T>
+        Line& operator<<(const T& value)
+        {
+            static_cast<std::ostream&>(_os) << value;
+            return *this;
+        }
+
+    private:
+        Verbosity _level;
+        std::ostringstream _os;
+    };
+
+private:
+    static std::atomic<Verbosity> _verbosity;
+};
+
+// A loop rather than an if, so that an else after the macro can't bind to it
+#define GTAD_LOG_(level)                                                       \
+    for (bool gtadLogOn_ = Log::enabled(level); gtadLogOn_;                    \
+         gtadLogOn_ = false)                                                   \
+        Log::Line(level)
+
+/// Details of analysis and rendering, shown with `--messages debug`
+#define GTAD_DEBUG GTAD_LOG_(Verbosity::Debug)
+/// Progress messages, shown unless `--messages quiet` is passed
+#define GTAD_INFO GTAD_LOG_(Verbosity::Basic)
+/// Problems that don't stop the generator; always shown
+#define GTAD_WARNING GTAD_LOG_(Verbosity::Quiet)
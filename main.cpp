@@ -17,14 +17,87 @@
  */
 
 #include "analyzer.h"
+#include "logger.h"
+#include "manifest.h"
 #include "printer.h"
+#include "profiler.h"
+#include "snapshot.h"
 #include "translator.h"
+#include "watcher.h"
 
 #include <QtCore/QCoreApplication>
 #include <QtCore/QCommandLineParser>
 
+#include <atomic>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <list>
+
+/// \brief Analyze the files of \p tasks, data schemas they refer to first
+///
+/// The files are scanned for `$ref`s, then the files they refer to, and so on;
+/// then each file is analyzed as soon as the files it refers to are, so that
+/// independent schemas are analyzed in parallel instead of each being loaded
+/// by the first thread to come across a reference to it. Schemas that the scan
+/// could not find are still loaded the usual way, when referred to.
+void analyzeInOrder(const std::vector<std::pair<Analyzer, std::string>>& tasks,
+                    InOut role, unsigned jobs)
+{
+    using namespace std;
+    // Each file gets its own analyzer, as analyzers keep per-file state
+    struct ScheduledFile {
+        Analyzer analyzer;
+        string filePath;
+        bool topLevel;
+    };
+    map<string, ScheduledFile> scheduledFiles;
+    DependencyGraph::edges_t dependencies;
+    struct ScanTask {
+        string key;
+        const Analyzer* analyzer;
+        string filePath;
+        vector<string> refs {};
+    };
+    vector<ScanTask> scanTasks;
+    for (const auto& [analyzer, filePath]: tasks) {
+        auto key = Analyzer::makeModelKey(filePath);
+        scheduledFiles.emplace(key, ScheduledFile { analyzer, filePath, true });
+        dependencies[key];
+        scanTasks.push_back({ move(key), &analyzer, filePath });
+    }
+    while (!scanTasks.empty()) {
+        forEachParallel(scanTasks, jobs, [](ScanTask& task) {
+            task.refs = task.analyzer->scanReferences(task.filePath);
+        });
+        vector<ScanTask> nextScanTasks;
+        for (auto& task: scanTasks)
+            for (auto& ref: task.refs) {
+                auto depKey = Analyzer::makeModelKey(ref);
+                dependencies[task.key].insert(depKey);
+                if (Analyzer::allModels().contains(depKey)
+                    || scheduledFiles.contains(depKey))
+                    continue;
+                dependencies[depKey];
+                scheduledFiles.emplace(depKey,
+                                       ScheduledFile { *task.analyzer, ref, false });
+                nextScanTasks.push_back({ move(depKey), task.analyzer, move(ref) });
+            }
+        scanTasks = move(nextScanTasks);
+    }
+
+    DependencyGraph(dependencies).forEachInOrder(jobs, [&](const string& key) {
+        const auto it = scheduledFiles.find(key);
+        if (it == scheduledFiles.end()) // Loaded by an earlier run
+            return;
+        auto& file = it->second;
+        if (file.topLevel)
+            file.analyzer.loadModel(file.filePath, role);
+        else
+            file.analyzer.preloadDependency(file.filePath);
+    });
+    Analyzer::dropUnusedPreloads();
+}
 
 int main(int argc, char* argv[])
 {
@@ -40,12 +113,16 @@ int main(int argc, char* argv[])
     parser.addVersionOption();
 
     QCommandLineOption configPathOption("config",
-        QCoreApplication::translate("main", "API generator configuration in YAML format"),
+        QCoreApplication::translate("main",
+            "API generator configuration in YAML format; can be given several"
+            " times, along with as many --out options"),
         "configfile");
     parser.addOption(configPathOption);
 
     QCommandLineOption outputDirOption("out",
-        QCoreApplication::translate("main", "Write generated files to <outputdir>."),
+        QCoreApplication::translate("main",
+            "Write generated files to <outputdir>; each --out goes with"
+            " the --config in the same position."),
         "outputdir");
     parser.addOption(outputDirOption);
 
@@ -60,6 +137,53 @@ int main(int argc, char* argv[])
         QCoreApplication::translate("main",
             "Configure the verbosity, one of: quiet, basic, and debug"),
         "verbosity", "basic");
+    parser.addOption(messagesRoleOption);
+
+    QCommandLineOption jobsOption({"j", "jobs"},
+        QCoreApplication::translate("main",
+            "Run up to <jobs> threads to analyze and render files"),
+        "jobs", "1");
+    parser.addOption(jobsOption);
+
+    QCommandLineOption incrementalOption("incremental",
+        QCoreApplication::translate("main",
+            "Skip the files that haven't changed, along with everything"
+            " they refer to, since the previous run"));
+    parser.addOption(incrementalOption);
+
+    QCommandLineOption snapshotOption("snapshot",
+        QCoreApplication::translate("main",
+            "Save the analyzed files to the output directory and, in the next"
+            " runs, restore the ones that haven't changed instead of analyzing"
+            " them again"));
+    parser.addOption(snapshotOption);
+
+    QCommandLineOption profileOption("profile",
+        QCoreApplication::translate("main",
+            "Print the time spent in each stage and for each file, along with"
+            " some counters, at the end of the run"));
+    parser.addOption(profileOption);
+
+    QCommandLineOption profileTraceOption("profile-trace",
+        QCoreApplication::translate("main",
+            "Same as --profile; additionally write the timeline of all stages"
+            " on all threads to <tracefile> in Chrome trace format"),
+        "tracefile");
+    parser.addOption(profileTraceOption);
+
+    QCommandLineOption watchOption("watch",
+        QCoreApplication::translate("main",
+            "After generating files, keep running and regenerate the files"
+            " affected by changes in the input files or the configuration"));
+    parser.addOption(watchOption);
+
+    QCommandLineOption dependencyGraphOption("dependency-graph",
+        QCoreApplication::translate("main",
+            "Write the graph of references between the loaded files to"
+            " <graphfile>, in Graphviz format if it ends with .dot or .gv and"
+            " as JSON otherwise"),
+        "graphfile");
+    parser.addOption(dependencyGraphOption);
 
     parser.addPositionalArgument("files",
         QCoreApplication::translate("main",
@@ -73,13 +197,16 @@ int main(int argc, char* argv[])
         using namespace std;
         namespace fs = filesystem;
 
+        const auto profileTracePath =
+            parser.value(profileTraceOption).toStdString();
+        if (parser.isSet(profileOption) || !profileTracePath.empty())
+            Profiler::enable(!profileTracePath.empty());
+
         const auto& verbosityArg = parser.value(messagesRoleOption);
         const auto verbosity = verbosityArg == "quiet"   ? Verbosity::Quiet
                                : verbosityArg == "debug" ? Verbosity::Debug
                                                          : Verbosity::Basic;
-        Translator translator {parser.value(configPathOption).toStdString(),
-                               parser.value(outputDirOption).toStdString(),
-                               verbosity};
+        Log::setVerbosity(verbosity);
 
         vector<fs::path> paths, exclusions;
         const auto& pathArgs = parser.positionalArguments();
@@ -92,26 +219,69 @@ int main(int argc, char* argv[])
         const auto& roleValue = parser.value(schemaRoleOption);
         const auto role =
             roleValue == "i" ? OnlyIn : roleValue == "o" ? OnlyOut : InAndOut;
+        bool jobsOk = false;
+        const auto jobs = parser.value(jobsOption).toUInt(&jobsOk);
+        if (!jobsOk || jobs == 0)
+            throw Exception("Invalid number of jobs: "
+                            + parser.value(jobsOption).toStdString());
 
-        for(const auto& path: paths) {
-            auto ftype = fs::status(path).type();
-            if (ftype == fs::file_type::regular)
-                Analyzer{translator}.loadModel(path.string(), role);
-
-            if (ftype != fs::file_type::directory)
-                continue;
-
-            Analyzer a{translator, path};
-            for (const auto& f: fs::directory_iterator(
-                     path, fs::directory_options::skip_permission_denied)) {
-                if (!f.is_regular_file())
-                    continue;
-                auto&& fName = f.path().filename();
-                if (find(exclusions.begin(), exclusions.end(), fName)
-                    == exclusions.cend())
-                    a.loadModel(fName.string(), role);
-            }
+        // Each configuration makes a target with its own translator and
+        // models (the analysis depends on the configuration); the parsed input
+        // files are shared between the targets
+        auto configPaths = parser.values(configPathOption);
+        auto outputDirPaths = parser.values(outputDirOption);
+        if (configPaths.isEmpty())
+            configPaths.push_back(QString());
+        if (outputDirPaths.isEmpty())
+            outputDirPaths.push_back(QString());
+        if (configPaths.size() != outputDirPaths.size())
+            throw Exception("The numbers of --config and --out options differ");
+        struct PrinterTask {
+            const Printer* printer;
+            const string* pathBase;
+            const Model* model;
+            vector<string> fileNames {};
+        };
+        struct Target {
+            string configFilePath;
+            string outputDirPath;
+            // Re-made in --watch mode when the configuration changes
+            unique_ptr<Translator> translator;
+            optional<DependencyManifest> manifest;
+            optional<ModelSnapshot> snapshot;
+            ModelRegistry models;
+            set<fs::path> inputFiles;
+            bool reloadAll = false;
+            // Between the analysis and the end of generation
+            unordered_set<string> loadedBefore;
+            vector<PrinterTask> printerTasks;
+        };
+        // The analysis (unlike the rendering) only depends on the settings
+        // and the configuration file, on top of the input files
+        const auto openSnapshot = [&](Target& target) {
+            if (parser.isSet(snapshotOption))
+                target.snapshot.emplace(
+                    target.translator->outputBaseDir() / ".gtad-models.bin",
+                    QCoreApplication::applicationVersion().toStdString()
+                        + ";role=" + roleValue.toStdString()
+                        + ";config=" + hashFile(target.configFilePath));
+        };
+        list<Target> targets; // ModelRegistry can't be moved
+        for (int i = 0; i < configPaths.size(); ++i) {
+            auto& target = targets.emplace_back();
+            target.configFilePath = configPaths.at(i).toStdString();
+            target.outputDirPath = outputDirPaths.at(i).toStdString();
+            target.translator = make_unique<Translator>(
+                target.configFilePath, target.outputDirPath, verbosity);
+            target.manifest.emplace(
+                target.translator->outputBaseDir() / ".gtad-dependencies.json",
+                QCoreApplication::applicationVersion().toStdString() + ";role="
+                    + roleValue.toStdString());
+            openSnapshot(target);
         }
+        const auto incremental = parser.isSet(incrementalOption);
+        const fs::path dependencyGraphPath =
+            parser.value(dependencyGraphOption).toStdString();
 
         using namespace literals;
         const char* clangFormatPath = getenv("CLANG_FORMAT");
@@ -120,34 +290,423 @@ int main(int argc, char* argv[])
         clangFormatCommand += " -i -sort-includes"sv;
         const char* clangFormatArgs = getenv("CLANG_FORMAT_ARGS");
         if (clangFormatArgs)
-            clangFormatCommand += clangFormatArgs;
-
-        size_t filesCounter = 0;
-        for (const auto& [pathBase, model]: Analyzer::allModels()) {
-            if (model.empty() || model.trivial())
-                continue;
-
-            auto targetDir = (translator.outputBaseDir() / pathBase)
-                                 .parent_path()
-                                 .lexically_normal();
-            fs::create_directories(targetDir);
-            if (!fs::exists(targetDir))
-                throw Exception{"Cannot create output directory "
-                                + targetDir.string()};
-            const auto fileNames = translator.printer().print(pathBase, model);
-            for (const auto& fName : fileNames)
-                clangFormatCommand += ' ' + fName;
-            filesCounter += fileNames.size();
+            (clangFormatCommand += ' ') += clangFormatArgs;
+
+        // Files emitted from each model are formatted in batches as soon as
+        // that model is rendered; a batch is additionally split if its
+        // command line gets longer than Windows (the tightest of all) allows
+        constexpr size_t MaxCommandLength = 8000;
+        atomic<size_t> formattingFailures = 0;
+        const auto formatFiles = [&](const vector<string>& fileNames) {
+            for (auto it = fileNames.begin(); it != fileNames.end();) {
+                auto command = clangFormatCommand;
+                const auto batchBegin = it;
+                for (; it != fileNames.end(); ++it) {
+                    const auto fPath = Printer::stagingPath(*it).string();
+                    if (it != batchBegin
+                        && command.size() + fPath.size() >= MaxCommandLength)
+                        break;
+                    (command += ' ') += fPath;
+                }
+                const Profiler::Scope profileScope { "clang-format",
+                                                     *batchBegin };
+                if (const auto status = system(command.c_str()); status != 0) {
+                    ++formattingFailures;
+                    string message = "Warning: formatting failed with status "
+                                     + to_string(status) + " for:";
+                    for (auto fIt = batchBegin; fIt != it; ++fIt)
+                        message += ' ' + *fIt;
+                    GTAD_WARNING << message;
+                }
+            }
+        };
+
+        // Analyze the input files that are not loaded yet for the target and
+        // prepare the models loaded by this call for rendering; the models
+        // that are already loaded (in --watch mode, by a previous call) are
+        // taken as is
+        const auto analyzeTarget = [&](Target& target) {
+            Analyzer::useRegistry(target.models);
+            const auto& configFilePath = target.configFilePath;
+            const auto& translator = target.translator;
+            auto& manifest = *target.manifest;
+            auto& snapshot = target.snapshot;
+            auto& inputFiles = target.inputFiles;
+            if (targets.size() > 1)
+                GTAD_INFO << "Analyzing files for " << configFilePath
+                          << " in " << translator->outputBaseDir();
+
+            auto& loadedBefore = target.loadedBefore;
+            loadedBefore.clear();
+            for (const auto& p: Analyzer::allModels())
+                loadedBefore.insert(p.first);
+            size_t skippedCounter = 0;
+            const auto upToDate = [&](const string& filePath) {
+                const auto key = Analyzer::makeModelKey(filePath);
+                const auto result =
+                    loadedBefore.contains(key)
+                    || (incremental && manifest.reuseIfUpToDate(key));
+                skippedCounter += result;
+                return result;
+            };
+
+            // Each analyzer is only used by one thread at a time; the ones
+            // made for a directory are copied to each task for that directory
+            vector<pair<Analyzer, string>> analyzerTasks;
+            for (const auto& path: paths) {
+                auto ftype = fs::status(path).type();
+                if (ftype == fs::file_type::regular) {
+                    inputFiles.insert(path);
+                    if (!upToDate(path.string()))
+                        analyzerTasks.emplace_back(Analyzer { *translator },
+                                                   path.string());
+                }
+
+                if (ftype != fs::file_type::directory)
+                    continue;
+
+                const Analyzer a { *translator, path };
+                for (const auto& f: fs::directory_iterator(
+                         path, fs::directory_options::skip_permission_denied)) {
+                    if (!f.is_regular_file())
+                        continue;
+                    auto&& fName = f.path().filename();
+                    if (find(exclusions.begin(), exclusions.end(), fName)
+                        != exclusions.cend())
+                        continue;
+                    inputFiles.insert(f.path());
+                    if (!upToDate(fName.string()))
+                        analyzerTasks.emplace_back(a, fName.string());
+                }
+            }
+            if (skippedCounter > 0)
+                GTAD_INFO << skippedCounter
+                          << " file(s) skipped as unchanged since the previous"
+                             " run";
+            // The skipped models still need the data models they refer to
+            // for the same roles as before
+            Analyzer::requireRoles(incremental ? manifest.rolesForReused()
+                                               : map<string, InOut>());
+            if (snapshot) {
+                set<string> taskKeys;
+                for (const auto& task: analyzerTasks)
+                    taskKeys.insert(Analyzer::makeModelKey(task.second));
+                const auto restoredKeys =
+                    Analyzer::restoreModels(*snapshot, taskKeys, *translator);
+                if (!restoredKeys.empty()) {
+                    GTAD_INFO << restoredKeys.size()
+                              << " model(s) restored from the snapshot";
+                    vector<pair<Analyzer, string>> remainingTasks;
+                    for (auto& task: analyzerTasks)
+                        if (!restoredKeys.contains(
+                                Analyzer::makeModelKey(task.second)))
+                            remainingTasks.push_back(move(task));
+                    analyzerTasks = move(remainingTasks);
+                }
+            }
+            {
+                const Profiler::Scope profileScope { "analysis (all files)" };
+                if (jobs == 1)
+                    forEachParallel(analyzerTasks, jobs, [role](auto& task) {
+                        task.first.loadModel(task.second, role);
+                    });
+                else
+                    analyzeInOrder(analyzerTasks, role, jobs);
+            }
+            // The models loaded before but extended to more roles (or
+            // reloaded for them) by this analysis are emitted again
+            for (const auto& key: Analyzer::takeUpdatedModels())
+                loadedBefore.erase(key);
+
+            // Sort models by their keys so that the emitted files list
+            // doesn't depend on threading or hashing
+            const auto& printer = translator->printer();
+            auto& printerTasks = target.printerTasks;
+            printerTasks.clear();
+            for (const auto& [pathBase, model]: Analyzer::allModels()) {
+                if (model.empty() || model.trivial()
+                    || loadedBefore.contains(pathBase))
+                    continue;
+
+                auto targetDir = (translator->outputBaseDir() / pathBase)
+                                     .parent_path()
+                                     .lexically_normal();
+                fs::create_directories(targetDir);
+                if (!fs::exists(targetDir))
+                    throw Exception{"Cannot create output directory "
+                                    + targetDir.string()};
+                printerTasks.push_back({ &printer, &pathBase, &model });
+            }
+            sort(printerTasks.begin(), printerTasks.end(),
+                 [](const PrinterTask& t1, const PrinterTask& t2) {
+                     return *t1.pathBase < *t2.pathBase;
+                 });
+        };
+
+        // Render the models of all analyzed targets with one pool of threads,
+        // so that a target with few models to render doesn't keep the threads
+        // idle until the next target can start
+        const auto renderTargets = [&](const vector<Target*>& analyzedTargets) {
+            vector<PrinterTask*> printerTasks;
+            for (auto* target: analyzedTargets)
+                for (auto& task: target->printerTasks)
+                    printerTasks.push_back(&task);
+            GTAD_INFO << "Rendering and formatting files for "
+                      << printerTasks.size() << " model(s)";
+            formattingFailures = 0;
+            {
+                const Profiler::Scope profileScope { "rendering (all files)" };
+                forEachParallel(printerTasks, jobs, [&](PrinterTask* task) {
+                    task->fileNames =
+                        task->printer->print(*task->pathBase, *task->model);
+                    formatFiles(task->fileNames);
+                });
+            }
+            if (formattingFailures > 0)
+                GTAD_WARNING << "Warning: " << formattingFailures
+                             << " formatting batch(es) failed, the respective"
+                                " files are written unformatted";
+        };
+
+        // Put the rendered files of the target in place and save the state
+        // of the target for the next run
+        const auto finishTarget = [&](Target& target) {
+            Analyzer::useRegistry(target.models);
+            const auto& configFilePath = target.configFilePath;
+            const auto& translator = target.translator;
+            auto& manifest = *target.manifest;
+            auto& snapshot = target.snapshot;
+            const auto& loadedBefore = target.loadedBefore;
+            const auto& printerTasks = target.printerTasks;
+            const auto& printer = translator->printer();
+
+            DependencyManifest::outputs_t outputs;
+            for (const auto& task: printerTasks)
+                outputs.emplace(*task.pathBase, task.fileNames);
+            for (const auto& [key, model]: Analyzer::allModels())
+                if (!loadedBefore.contains(key)) {
+                    auto outIt = outputs.find(key);
+                    manifest.record(key, model, Analyzer::allModels(),
+                                    outIt != outputs.end()
+                                        ? move(outIt->second)
+                                        : vector<string>());
+                }
+
+            // The emitted files list includes the files emitted before from
+            // the models skipped in this run
+            const auto allOutputs = manifest.reusedOutputs();
+            vector<string> allFileNames;
+            for (const auto& [pathBase, fileNames]: allOutputs)
+                allFileNames.insert(allFileNames.end(), fileNames.begin(),
+                                    fileNames.end());
+            printer.writeOutFilesList(allFileNames);
+
+            // allOutputs has the models rendered in this run as well
+            vector<Printer::EmittedFile> emittedFiles;
+            if (printer.hasEmissionManifest()) {
+                set<string> renderedKeys;
+                for (const auto& task: printerTasks)
+                    renderedKeys.insert(*task.pathBase);
+                for (const auto& [pathBase, fileNames]: allOutputs)
+                    if (!renderedKeys.contains(pathBase))
+                        for (const auto& fName: fileNames)
+                            emittedFiles.push_back(
+                                { fName, pathBase, {}, false });
+            }
+            size_t renderedCounter = 0;
+            size_t writtenCounter = 0;
+            {
+                const Profiler::Scope profileScope { "replace changed files" };
+                for (const auto& task: printerTasks)
+                    for (const auto& fName: task.fileNames) {
+                        FileDigest digest;
+                        const auto rewritten = replaceIfChanged(
+                            Printer::stagingPath(fName), fName,
+                            printer.hasEmissionManifest() ? &digest : nullptr);
+                        ++renderedCounter;
+                        writtenCounter += rewritten;
+                        if (printer.hasEmissionManifest())
+                            emittedFiles.push_back(
+                                { fName, *task.pathBase,
+                                  translator->outputTemplateName(
+                                      *task.pathBase, *task.model, fName),
+                                  rewritten, move(digest) });
+                    }
+                for (const auto& task: printerTasks)
+                    for (const auto& fName: task.fileNames) {
+                        // Leave staging directories alone if not empty
+                        error_code ec;
+                        fs::remove(Printer::stagingPath(fName).parent_path(),
+                                   ec);
+                    }
+            }
+            GTAD_INFO << writtenCounter << " written, "
+                      << renderedCounter - writtenCounter << " unchanged";
+            if (printer.hasEmissionManifest()) {
+                const Profiler::Scope profileScope {
+                    "write emission manifest"
+                };
+                printer.writeEmissionManifest(move(emittedFiles));
+            }
+
+            auto commonInputs = printer.partialFiles();
+            commonInputs.insert(configFilePath);
+            manifest.save(commonInputs);
+            if (snapshot) {
+                const Profiler::Scope profileScope { "save snapshot" };
+                snapshot->save(Analyzer::allModels());
+            }
+            // With several targets, the graph is written for the first one
+            const auto writeGraph =
+                !dependencyGraphPath.empty() && &target == &targets.front();
+            if (verbosity == Verbosity::Debug || writeGraph) {
+                const auto graph = Analyzer::dependencyGraph();
+                GTAD_DEBUG << graph.keys().size() << " model(s) in "
+                           << graph.waves().size()
+                           << " wave(s) of dependencies";
+                if (writeGraph) {
+                    ofstream ofs { dependencyGraphPath };
+                    if (!ofs.good())
+                        throw Exception(dependencyGraphPath.string()
+                                        + ": Couldn't open for writing");
+                    const auto& ext = dependencyGraphPath.extension();
+                    if (ext == ".dot" || ext == ".gv")
+                        graph.writeDot(ofs);
+                    else
+                        graph.writeJson(ofs);
+                }
+            }
+            if (verbosity == Verbosity::Debug)
+                translator->dumpStatistics();
+            target.printerTasks.clear();
+        };
+        // In --watch mode, errors are reported and the affected targets are
+        // regenerated from scratch on the next change, as their models may
+        // be left half-loaded
+        const auto tryFor = [](const vector<Target*>& affectedTargets,
+                               const auto& fn) {
+            try {
+                fn();
+                return true;
+            } catch (Exception& e) {
+                GTAD_WARNING << e.message;
+            } catch (exception& e) {
+                GTAD_WARNING << e.what();
+            }
+            for (auto* target: affectedTargets)
+                target->reloadAll = true;
+            return false;
+        };
+        const auto printProfile = [&] {
+            if (Profiler::enabled()) {
+                Log::flush();
+                Profiler::printSummary(clog);
+                if (!profileTracePath.empty())
+                    Profiler::writeTrace(profileTracePath);
+            }
+        };
+
+        // Targets are analyzed one after another, each using all the threads;
+        // the models of all targets are then rendered together
+        vector<Target*> allTargets;
+        for (auto& target: targets) {
+            analyzeTarget(target);
+            allTargets.push_back(&target);
+        }
+        renderTargets(allTargets);
+        for (auto* target: allTargets)
+            finishTarget(*target);
+        printProfile();
+        if (parser.isSet(watchOption)) {
+            // Everything stays loaded between passes; only the models made
+            // from the changed files and the models referring to them are
+            // reloaded, unless the configuration or a partial changes
+            FileWatcher watcher;
+            for (;;) {
+                set<fs::path> watchedFiles { paths.begin(), paths.end() };
+                for (auto& target: targets) {
+                    Analyzer::useRegistry(target.models);
+                    watchedFiles.merge(set<fs::path>(target.inputFiles));
+                    watchedFiles.insert(target.configFilePath);
+                    if (target.translator)
+                        watchedFiles.merge(
+                            target.translator->printer().partialFiles());
+                    for (const auto& [key, model]: Analyzer::allModels())
+                        watchedFiles.insert(model.srcPath);
+                    for (const auto& fPath: target.manifest->recordedInputs())
+                        watchedFiles.insert(fPath);
+                }
+                watcher.watch(watchedFiles);
+                GTAD_INFO << "Watching " << watchedFiles.size()
+                          << " file(s) for changes";
+                Log::flush();
+
+                const auto changedFiles = watcher.waitForChanges();
+                vector<Target*> analyzedTargets;
+                for (auto& target: targets) {
+                    auto& translator = target.translator;
+                    auto& manifest = *target.manifest;
+                    target.reloadAll =
+                        target.reloadAll || !translator
+                        || changedFiles.contains(target.configFilePath)
+                        || any_of(changedFiles.begin(), changedFiles.end(),
+                                  [&translator](const fs::path& fPath) {
+                                      return translator->printer()
+                                          .partialFiles()
+                                          .contains(fPath);
+                                  });
+                    const auto analyzed = tryFor({ &target }, [&] {
+                        Analyzer::useRegistry(target.models);
+                        manifest.resetHashes();
+                        if (target.snapshot)
+                            target.snapshot->resetHashes();
+                        if (target.reloadAll) {
+                            GTAD_INFO << "The configuration has changed,"
+                                         " regenerating everything";
+                            for (const auto& p: Analyzer::allModels())
+                                manifest.forget(p.first);
+                            Analyzer::clearAllModels();
+                            Analyzer::clearDocumentCache();
+                            translator.reset();
+                            translator = make_unique<Translator>(
+                                target.configFilePath, target.outputDirPath,
+                                verbosity);
+                            // Made with the old configuration
+                            target.snapshot.reset();
+                            openSnapshot(target);
+                        } else {
+                            const auto affectedModels =
+                                Analyzer::dependentModels(changedFiles);
+                            GTAD_INFO << changedFiles.size()
+                                      << " file(s) changed, reloading "
+                                      << affectedModels.size() << " model(s)";
+                            for (const auto& key: affectedModels)
+                                manifest.forget(key);
+                            Analyzer::forgetModels(affectedModels);
+                        }
+                        analyzeTarget(target);
+                    });
+                    if (analyzed)
+                        analyzedTargets.push_back(&target);
+                }
+                if (!tryFor(analyzedTargets,
+                            [&] { renderTargets(analyzedTargets); }))
+                    analyzedTargets.clear();
+                for (auto* target: analyzedTargets)
+                    if (tryFor({ target }, [&] { finishTarget(*target); }))
+                        target->reloadAll = false;
+                printProfile();
+            }
         }
-        cout << "Formatting " << filesCounter << " files\n";
-        system(clangFormatCommand.c_str());
     }
     catch (Exception& e)
     {
+        Log::flush();
         std::cerr << e.message << std::endl;
         return 3;
     }
     catch (std::exception& e) {
+        Log::flush();
         std::cerr << e.what() << std::endl;
         return 3;
     }
@@ -0,0 +1,247 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "manifest.h"
+
+#include "logger.h"
+#include "yaml.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+namespace fs = filesystem;
+
+map<string, string> loadHashes(const YamlMap& yaml)
+{
+    map<string, string> result;
+    for (const auto& p: yaml)
+        result.emplace(p.first.as<string>(), p.second.as<string>());
+    return result;
+}
+
+optional<InOut> loadRole(const string& roleString)
+{
+    for (const auto r: { InAndOut, OnlyIn, OnlyOut })
+        if (roleString == string(1, roleToChar(r)))
+            return r;
+    return {};
+}
+
+DependencyManifest::DependencyManifest(fspath filePath, string settings)
+    : _filePath(move(filePath)), _settings(move(settings))
+{
+    if (!fs::exists(_filePath))
+        return;
+
+    try {
+        // JSON is a subset of YAML
+        const auto yaml = YamlMap::loadFromFile(_filePath);
+        _previousSettingsMatch = yaml["settings"].as<string>("") == _settings;
+        _previousCommonInputs = loadHashes(yaml["common"].asMap());
+        for (const auto& p: yaml["models"].asMap()) {
+            const auto entryYaml = p.second.asMap();
+            _previousEntries.emplace(
+                p.first.as<string>(),
+                Entry { loadHashes(entryYaml["inputs"].asMap()),
+                        entryYaml["dependencies"].asSequence().asStrings(),
+                        entryYaml["outputs"].asSequence().asStrings(),
+                        loadRole(entryYaml["role"].as<string>("")) });
+        }
+    } catch (Exception& e) {
+        GTAD_WARNING << "Warning: ignoring the invalid manifest at "
+                     << _filePath << ": " << e.message;
+        _previousSettingsMatch = false;
+    } catch (YAML::Exception& e) {
+        GTAD_WARNING << "Warning: ignoring the invalid manifest at "
+                     << _filePath << ": " << e.what();
+        _previousSettingsMatch = false;
+    }
+}
+
+const string& DependencyManifest::currentHash(const string& filePath)
+{
+    auto it = _currentHashes.find(filePath);
+    if (it == _currentHashes.end())
+        it = _currentHashes.emplace(filePath, hashFile(filePath)).first;
+    return it->second;
+}
+
+bool DependencyManifest::unchanged(const hashes_t& inputs)
+{
+    return all_of(inputs.begin(), inputs.end(), [this](const auto& p) {
+        return !p.second.empty() && currentHash(p.first) == p.second;
+    });
+}
+
+bool DependencyManifest::reuseIfUpToDate(const string& modelKey)
+{
+    if (!_previousSettingsMatch || !unchanged(_previousCommonInputs))
+        return false;
+
+    const auto it = _previousEntries.find(modelKey);
+    if (it == _previousEntries.end() || !unchanged(it->second.inputs))
+        return false;
+
+    const auto& outputs = it->second.outputs;
+    if (!all_of(outputs.begin(), outputs.end(),
+                [](const string& fName) { return fs::exists(fName); }))
+        return false;
+
+    reuse(modelKey);
+    return true;
+}
+
+void DependencyManifest::reuse(const string& modelKey)
+{
+    const auto it = _previousEntries.find(modelKey);
+    if (it == _previousEntries.end() || _entries.contains(modelKey))
+        return;
+    _entries.emplace(*it);
+    _reusedKeys.insert(modelKey);
+    for (const auto& depKey: it->second.dependencies)
+        reuse(depKey);
+}
+
+DependencyManifest::outputs_t DependencyManifest::reusedOutputs() const
+{
+    outputs_t result;
+    for (const auto& [key, entry]: _entries)
+        result.emplace(key, entry.outputs);
+    return result;
+}
+
+map<string, InOut> DependencyManifest::rolesForReused() const
+{
+    // Data models that are reused themselves are listed too: the models that
+    // are not reused may still refer to them and load them again
+    map<string, InOut> result;
+    for (const auto& key: _reusedKeys)
+        if (const auto it = _previousEntries.find(key);
+            it != _previousEntries.end())
+            for (const auto& depKey: it->second.dependencies)
+                if (const auto depIt = _previousEntries.find(depKey);
+                    depIt != _previousEntries.end() && depIt->second.role) {
+                    const auto [roleIt, inserted] =
+                        result.try_emplace(depKey, *depIt->second.role);
+                    if (!inserted)
+                        roleIt->second =
+                            unionRole(roleIt->second, *depIt->second.role);
+                }
+    return result;
+}
+
+void DependencyManifest::record(const string& modelKey, const Model& model,
+                                const models_t& models, vector<string> outputs)
+{
+    Entry entry;
+    // Collect the source files of all models this one depends on
+    vector<const Model*> modelsToVisit { &model };
+    set<string> visitedKeys { modelKey };
+    while (!modelsToVisit.empty()) {
+        const auto* m = modelsToVisit.back();
+        modelsToVisit.pop_back();
+        entry.inputs.emplace(m->srcPath, currentHash(m->srcPath));
+        for (const auto& depKey: m->dependencies)
+            if (const auto depIt = models.find(depKey);
+                depIt != models.end() && visitedKeys.insert(depKey).second)
+                modelsToVisit.push_back(&depIt->second);
+    }
+    entry.dependencies.assign(model.dependencies.begin(),
+                              model.dependencies.end());
+    entry.outputs = move(outputs);
+    if (model.apiSpec == ApiSpec::JSONSchema && !model.types.empty())
+        entry.role = model.types.back().role;
+    _reusedKeys.erase(modelKey);
+    _entries.insert_or_assign(modelKey, move(entry));
+}
+
+set<string> DependencyManifest::recordedInputs() const
+{
+    set<string> result;
+    for (const auto& [key, entry]: _entries)
+        for (const auto& p: entry.inputs)
+            result.insert(p.first);
+    return result;
+}
+
+void writeHashes(ostream& os, const map<string, string>& hashes,
+                 const char* indent)
+{
+    os << '{';
+    const char* separator = "\n";
+    for (const auto& [filePath, hash]: hashes) {
+        os << separator << indent << "  " << toJsonString(filePath) << ": "
+           << toJsonString(hash);
+        separator = ",\n";
+    }
+    os << '\n' << indent << '}';
+}
+
+void writeStrings(ostream& os, const vector<string>& strings)
+{
+    os << '[';
+    const char* separator = "";
+    for (const auto& s: strings) {
+        os << separator << toJsonString(s);
+        separator = ", ";
+    }
+    os << ']';
+}
+
+void DependencyManifest::save(const set<fspath>& commonInputs)
+{
+    // Files used in the previous run still matter for the models reused
+    // from it, even if nothing loaded them this time
+    set<string> commonPaths;
+    if (_previousSettingsMatch)
+        for (const auto& p: _previousCommonInputs)
+            commonPaths.insert(p.first);
+    for (const auto& fPath: commonInputs)
+        commonPaths.insert(fPath.string());
+    hashes_t commonHashes;
+    for (const auto& fPath: commonPaths)
+        if (const auto& hash = currentHash(fPath); !hash.empty())
+            commonHashes.emplace(fPath, hash);
+
+    ostringstream os;
+    os << "{\n  \"settings\": " << toJsonString(_settings)
+       << ",\n  \"common\": ";
+    writeHashes(os, commonHashes, "  ");
+    os << ",\n  \"models\": {";
+    const char* separator = "\n";
+    for (const auto& [key, entry]: _entries) {
+        os << separator << "    " << toJsonString(key) << ": {\n"
+           << "      \"inputs\": ";
+        writeHashes(os, entry.inputs, "      ");
+        os << ",\n      \"dependencies\": ";
+        writeStrings(os, entry.dependencies);
+        os << ",\n      \"outputs\": ";
+        writeStrings(os, entry.outputs);
+        if (entry.role)
+            os << ",\n      \"role\": \"" << roleToChar(*entry.role) << '"';
+        os << "\n    }";
+        separator = ",\n";
+    }
+    os << "\n  }\n}\n";
+
+    ofstream ofs { _filePath };
+    if (!ofs.good())
+        throw Exception(_filePath.string() + ": Couldn't open for writing");
+    ofs << os.str();
+}
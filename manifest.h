@@ -0,0 +1,104 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "model.h"
+
+#include <filesystem>
+#include <map>
+
+/// \brief A persistent record of the inputs each model has been made from
+///
+/// The manifest lives in the output directory. For every model loaded in
+/// the previous run it has the hashes of all files the model depends on (its
+/// own source file along with the sources of all models it refers to,
+/// recursively) and the list of files emitted from it. On top of that,
+/// the manifest has the settings of the run and the hashes of files that
+/// all models depend on, such as the configuration and the partials
+/// loaded from files.
+class DependencyManifest
+{
+public:
+    using string = std::string;
+    using fspath = std::filesystem::path;
+    using models_t = std::unordered_map<string, Model>;
+    using outputs_t = std::map<string, std::vector<string>>;
+
+    /// \brief Load the manifest from \p filePath, if it's there
+    /// \param settings a string with anything else that affects the results;
+    ///        if it changes nothing from the previous run is considered
+    ///        up to date
+    DependencyManifest(fspath filePath, string settings);
+
+    /// \brief Check that nothing \p modelKey depends on has changed
+    ///
+    /// If the model is up to date, its record (along with the records of
+    /// the models it refers to) is carried over to the next run.
+    /// \return true if the model along with all its dependencies is unchanged
+    ///         since the previous run and the files emitted from it exist
+    bool reuseIfUpToDate(const string& modelKey);
+    /// Files emitted in the previous run from models that are up to date
+    [[nodiscard]] outputs_t reusedOutputs() const;
+    /// \brief The roles of data models that the reused models refer to
+    ///
+    /// The reused models are not analyzed again, so the data models they
+    /// refer to should keep (at least) the roles they had in the previous
+    /// run if they are analyzed again for other models.
+    [[nodiscard]] std::map<string, InOut> rolesForReused() const;
+
+    /// \brief Record inputs of a loaded model and the files emitted from it
+    /// \param models all loaded models, to find the ones \p model refers to
+    void record(const string& modelKey, const Model& model,
+                const models_t& models, std::vector<string> outputs);
+    /// Drop the record of a model, e.g. because it's going to be reloaded
+    void forget(const string& modelKey)
+    {
+        _entries.erase(modelKey);
+        _reusedKeys.erase(modelKey);
+    }
+    /// Files the recorded models have been made from
+    [[nodiscard]] std::set<string> recordedInputs() const;
+    /// Hash the files anew next time, as they may have changed since
+    void resetHashes() { _currentHashes.clear(); }
+    /// \brief Save the manifest, with all the records reused or made so far
+    /// \param commonInputs files all models depend on
+    void save(const std::set<fspath>& commonInputs);
+
+private:
+    using hashes_t = std::map<string, string>;
+    struct Entry {
+        hashes_t inputs;
+        std::vector<string> dependencies;
+        std::vector<string> outputs;
+        std::optional<InOut> role {}; ///< Of the main schema of a data model
+    };
+
+    fspath _filePath;
+    string _settings;
+    bool _previousSettingsMatch = false;
+    hashes_t _previousCommonInputs;
+    std::map<string, Entry> _previousEntries;
+    std::map<string, Entry> _entries;
+    std::set<string> _reusedKeys;
+    std::unordered_map<string, string> _currentHashes;
+
+    [[nodiscard]] const string& currentHash(const string& filePath);
+    [[nodiscard]] bool unchanged(const hashes_t& inputs);
+    void reuse(const string& modelKey);
+};
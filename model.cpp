@@ -18,47 +18,71 @@ TypeUsage::TypeUsage(const ObjectSchema& schema)
 TypeUsage TypeUsage::specialize(vector<TypeUsage>&& params) const
 {
     auto tu = *this;
-    tu.paramTypes = params;
+    tu.paramTypes = move(params);
     return tu;
 }
 
-void capitalize(string& s, string::size_type pos = 0)
+const TypeDefinition::attributes_type& TypeUsage::attributes() const
 {
-    if (pos < s.size())
-        s[pos] = toupper(s[pos], locale::classic());
+    static const TypeDefinition::attributes_type noAttributes {};
+    return definition ? definition->attributes : noAttributes;
 }
 
-string capitalizedCopy(string s)
+const TypeDefinition::lists_type& TypeUsage::lists() const
 {
-    capitalize(s);
-    return s;
+    static const TypeDefinition::lists_type noLists {};
+    return definition ? definition->lists : noLists;
 }
 
-string camelCase(string s)
+string capitalizedCopy(string_view s)
 {
+    string result { s };
+    if (!result.empty())
+        result.front() = toupper(result.front(), locale::classic());
+    return result;
+}
+
+string camelCase(string_view s)
+{
+    // Separators are dropped, capitalising the next character, except '_'
+    // at the beginning or the end of an identifier; all other
+    // non-identifier characters are removed but still count as taking
+    // a position in the identifier
+    string result;
+    result.reserve(s.size());
+    bool capitalizeNext = true;
     string::size_type pos = 0;
-    while (pos < s.size())
-    {
-        capitalize(s, pos);
-        pos = s.find_first_of("/_ .-:", pos);
-        if (pos == string::npos)
-            break;
-        // Do not erase '_' at the beginning or the end of an identifier
-        if (s[pos] != '_' || (pos != 0 && pos != s.size() - 1))
-            s.erase(pos, 1);
-        else
+    for (string::size_type i = 0; i < s.size(); ++i) {
+        const auto c = s[i];
+        if (string_view("/_ .-:").find(c) != string_view::npos) {
+            capitalizeNext = true;
+            if (c != '_' || (pos != 0 && i != s.size() - 1))
+                continue;
             ++pos;
+            result.push_back(c);
+            continue;
+        }
+        ++pos;
+        if (isalnum(c, locale::classic()) || c == '_')
+            result.push_back(capitalizeNext ? toupper(c, locale::classic())
+                                            : c);
+        capitalizeNext = false;
     }
-    // Remove all remaining non-identifier characters
-    s.erase(remove_if(s.begin(), s.end(),
-                      [] (auto c) { return !isalnum(c) && c != '_'; }),
-            s.end());
-    return s;
+    return result;
 }
 
-string withoutSuffix(const string& path, string_view suffix)
+string lowerCamelCase(string_view s)
 {
-    return path.substr(0, path.find(suffix, path.size() - suffix.size()));
+    auto result = camelCase(s);
+    if (!result.empty())
+        result.front() = tolower(result.front(), locale::classic());
+    return result;
+}
+
+string_view withoutSuffix(string_view path, string_view suffix)
+{
+    return path.ends_with(suffix) ? path.substr(0, path.size() - suffix.size())
+                                  : path;
 }
 
 string VarDecl::toString(bool withDefault) const
@@ -69,6 +93,42 @@ string VarDecl::toString(bool withDefault) const
     return result;
 }
 
+optional<VarDecl> VarDecls::add(VarDecl&& v)
+{
+    updateIndex();
+    optional<VarDecl> result;
+    if (const auto it = _nameIndex.find(v.name); it != _nameIndex.end()) {
+        const auto pos = it->second;
+        result = move((*this)[pos]);
+        erase(begin() + ptrdiff_t(pos));
+        _nameIndex.erase(it);
+        // Redefinitions are rare enough to afford shifting the tail
+        for (auto& p: _nameIndex)
+            if (p.second > pos)
+                --p.second;
+    }
+    _nameIndex.emplace(v.name, size());
+    emplace_back(move(v));
+    _indexedCount = size();
+    return result;
+}
+
+vector<VarDecl> VarDecls::take()
+{
+    auto result = move(static_cast<vector&>(*this));
+    clear();
+    _nameIndex.clear();
+    _indexedCount = 0;
+    return result;
+}
+
+void VarDecls::updateIndex()
+{
+    for (; _indexedCount < size(); ++_indexedCount)
+        _nameIndex.insert_or_assign((*this)[_indexedCount].name,
+                                    _indexedCount);
+}
+
 Path::Path(string path)
     : string(move(path))
 {
@@ -80,6 +140,7 @@ Path::Path(string path)
     while (back() == ' ' || back() == '/')
         pop_back();
 
+    parts.reserve(2 * size_t(count(begin(), end(), '{')) + 1);
     for (size_type i = 0; i < size();)
     {
         const auto i1 = find('{', i);
@@ -116,8 +177,8 @@ Call::params_type& Call::getParamsBlock(const string& blockName)
 
 Call::params_type Call::collateParams() const
 {
-    params_type allCollated;
-    for (auto c: params)
+    vector<VarDecl> allCollated;
+    for (const auto& c: params)
         allCollated.insert(allCollated.end(), c.begin(), c.end());
     dispatchVisit(
         body,
@@ -134,7 +195,7 @@ Call::params_type Call::collateParams() const
 
     stable_partition(allCollated.begin(), allCollated.end(),
                      [] (const VarDecl& v) { return v.required; });
-    return allCollated;
+    return params_type(move(allCollated));
 }
 
 Call& Model::addCall(Path path, string verb, string operationId, bool needsToken)
@@ -148,19 +209,24 @@ Call& Model::addCall(Path path, string verb, string operationId, bool needsToken
 
 void Model::addSchema(ObjectSchema&& schema)
 {
-    auto dupIt = find_if(types.begin(), types.end(),
-            [&](const ObjectSchema& s)
-            {
-                return s.call == schema.call &&
-                        s.name == schema.name;
-            });
-    if (dupIt != types.end())
+    if (!_schemasIndex.try_emplace({ schema.call, schema.name }, types.size())
+             .second)
         return;
 
     addImportsFrom(schema);
     types.emplace_back(move(schema));
 }
 
+void Model::renameSchema(ObjectSchema& schema, string newName)
+{
+    const auto pos = static_cast<size_t>(&schema - types.data());
+    if (const auto it = _schemasIndex.find({ schema.call, schema.name });
+        it != _schemasIndex.end() && it->second == pos)
+        _schemasIndex.erase(it);
+    schema.name = move(newName);
+    _schemasIndex.try_emplace({ schema.call, schema.name }, pos);
+}
+
 void Model::addImportsFrom(const ObjectSchema& s)
 {
     for (const auto& pt : s.parentTypes)
@@ -178,12 +244,14 @@ void Model::addImportsFrom(const FlatSchema& s)
 
 void Model::addImportsFrom(const TypeUsage& type)
 {
-    const auto renderer = type.attributes.at("_importRenderer");
-    const auto singleTypeImport = type.attributes.find("imports");
-    if (singleTypeImport != type.attributes.end())
+    const auto& attributes = type.attributes();
+    const auto& renderer = attributes.at("_importRenderer");
+    const auto singleTypeImport = attributes.find("imports");
+    if (singleTypeImport != attributes.end())
         imports.emplace(singleTypeImport->second, renderer);
-    const auto typeImportsIt = type.lists.find("imports");
-    if (typeImportsIt != type.lists.end())
+    const auto& lists = type.lists();
+    const auto typeImportsIt = lists.find("imports");
+    if (typeImportsIt != lists.end())
         for (auto&& import : typeImportsIt->second)
             imports.emplace(import, renderer);
     for (const auto& paramType : type.paramTypes)
@@ -195,7 +263,12 @@ void Model::clear()
     apiSpec.clear();
     imports.clear();
     types.clear();
+    _schemasIndex.clear();
     hostAddress.clear();
     basePath.clear();
     callClasses.clear();
+    srcPath.clear();
+    dependencies.clear();
+    roleSensitive = false;
+    preloaded = false;
 }
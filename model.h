@@ -22,13 +22,19 @@
 
 #include <array>
 #include <list>
+#include <optional>
+#include <set>
 #include <unordered_set>
 #include <unordered_map>
 #include <variant>
 
-std::string capitalizedCopy(std::string s);
-std::string camelCase(std::string s);
-std::string withoutSuffix(const std::string& path, std::string_view suffix);
+std::string capitalizedCopy(std::string_view s);
+std::string camelCase(std::string_view s);
+/// camelCase() with the first letter in lower case
+std::string lowerCamelCase(std::string_view s);
+/// \p path without \p suffix at its end, if it's there; no copies are made
+std::string_view withoutSuffix(std::string_view path,
+                               std::string_view suffix);
 
 enum InOut : unsigned char { InAndOut = 0, OnlyIn, OnlyOut };
 
@@ -37,6 +43,12 @@ constexpr inline char roleToChar(InOut r)
     return r == OnlyIn ? '>' : r == OnlyOut ? '<' : '.';
 }
 
+/// The narrowest role that covers both \p r1 and \p r2
+constexpr inline InOut unionRole(InOut r1, InOut r2)
+{
+    return r1 == r2 ? r1 : InAndOut;
+}
+
 template <typename StreamT>
 inline StreamT& operator<<(StreamT& s, const InOut& v)
 {
@@ -60,33 +72,49 @@ struct Identifier
 
 struct ObjectSchema;
 
-struct TypeUsage : Identifier
+/// \brief The part of a type definition that doesn't depend on its usage
+///
+/// Type definitions are produced from the configuration and interned by
+/// Translator so that equal definitions are always the same object and can be
+/// freely shared between type usages (#22).
+struct TypeDefinition
 {
-    using imports_type = std::vector<std::string>;
+    using attributes_type = std::unordered_map<std::string, std::string>;
+    using lists_type =
+        std::unordered_map<std::string, std::vector<std::string>>;
+
+    attributes_type attributes;
+    lists_type lists;
+
+    [[nodiscard]] bool operator==(const TypeDefinition& other) const = default;
+};
 
+struct TypeUsage : Identifier
+{
     std::string baseName; ///< As used in the API definition
-    std::unordered_map<std::string, std::string> attributes;
-    std::unordered_map<std::string, std::vector<std::string>> lists;
+    /// Interned definition shared with other usages, see TypeDefinition
+    const TypeDefinition* definition = nullptr;
     std::vector<TypeUsage> paramTypes; ///< Parameter types for type templates
 
     TypeUsage() = default;
-    explicit TypeUsage(std::string typeName) : Identifier{move(typeName)} { }
+    explicit TypeUsage(std::string typeName,
+                       const TypeDefinition* definition = nullptr)
+        : Identifier{move(typeName)}, definition(definition)
+    { }
     explicit TypeUsage(const ObjectSchema& schema);
 
     [[nodiscard]] TypeUsage specialize(std::vector<TypeUsage>&& params) const;
 
     [[nodiscard]] bool empty() const { return name.empty(); }
 
-    void addImport(imports_type::value_type importName)
-    {
-        lists["imports"].emplace_back(move(importName));
-    }
+    [[nodiscard]] const TypeDefinition::attributes_type& attributes() const;
+    [[nodiscard]] const TypeDefinition::lists_type& lists() const;
 
     [[nodiscard]] bool operator==(const TypeUsage& other) const
     {
         return name == other.name && call == other.call
-               && baseName == other.baseName && attributes == other.attributes
-               && lists == other.lists && paramTypes == other.paramTypes;
+               && baseName == other.baseName && definition == other.definition
+               && paramTypes == other.paramTypes;
     }
     [[nodiscard]] bool operator!=(const TypeUsage& other) const
     {
@@ -101,6 +129,10 @@ struct VarDecl : Identifier {
     string description;
     bool required = false;
     string defaultValue;
+    /// \brief The name in lowerCamelCase, made once for all the renderings
+    ///
+    /// Set along with the name by the constructor and rename().
+    string nameCamelCase;
 
     VarDecl() = default;
     VarDecl(TypeUsage type, string varName, string baseName, string description,
@@ -108,12 +140,60 @@ struct VarDecl : Identifier {
         : Identifier{move(varName)}, type(std::move(type))
         , baseName(move(baseName)), description(move(description))
         , required(required), defaultValue(move(defaultValue))
+        , nameCamelCase(lowerCamelCase(name))
     {}
 
+    void rename(string newName)
+    {
+        name = move(newName);
+        nameCamelCase = lowerCamelCase(name);
+    }
+
     [[nodiscard]] std::string toString(bool withDefault = false) const;
 };
 
-using VarDecls = std::vector<VarDecl>;
+/// \brief A list of variable declarations, indexed by their names
+///
+/// The list keeps the order of declarations (templates rely on it) while
+/// add() finds a declaration with the same name in constant time. Only
+/// appending and taking the whole list away are allowed besides add();
+/// the index covers a prefix of the list and catches up with appended
+/// declarations when needed, so it never has to be rebuilt.
+class VarDecls : private std::vector<VarDecl> {
+public:
+    using vector::vector;
+    using vector::value_type;
+    using vector::size_type;
+    using vector::const_iterator;
+    using vector::size;
+    using vector::empty;
+
+    explicit VarDecls(std::vector<VarDecl> decls) : vector(std::move(decls))
+    { }
+
+    [[nodiscard]] const_iterator begin() const { return vector::begin(); }
+    [[nodiscard]] const_iterator end() const { return vector::end(); }
+
+    /// \brief Add a declaration to the end of the list
+    ///
+    /// A declaration with the same name, if there's one, is removed.
+    /// \return the removed declaration, if any
+    std::optional<VarDecl> add(VarDecl&& v);
+    /// \brief Add a declaration to the end of the list as is
+    ///
+    /// Unlike add(), this doesn't look for a declaration with the same name;
+    /// if there's one, add() only replaces the last of them.
+    void append(VarDecl&& v) { emplace_back(std::move(v)); }
+    /// Get the declarations out of the list, leaving it empty
+    [[nodiscard]] std::vector<VarDecl> take();
+
+private:
+    std::unordered_map<std::string, size_t> _nameIndex;
+    /// The number of declarations at the beginning covered by the index
+    size_t _indexedCount = 0;
+
+    void updateIndex();
+};
 
 struct FlatSchema : Identifier {
     explicit FlatSchema(InOut inOut, const Call* scope = nullptr)
@@ -204,6 +284,12 @@ struct Path : public std::string
     enum PartKind { Literal, Variable };
     using part_type = std::tuple<size_type /*from*/, size_type /*to*/, PartKind>;
     std::vector<part_type> parts;
+
+    [[nodiscard]] std::string_view partView(const part_type& part) const
+    {
+        return std::string_view(*this).substr(std::get<0>(part),
+                                              std::get<1>(part));
+    }
 };
 
 struct Response
@@ -231,8 +317,9 @@ struct Call : Identifier {
 
     Call(Path callPath, string callVerb, string callName,
          bool callNeedsSecurity)
-        : Identifier{move(callName)}, path(move(callPath))
-        , verb(move(callVerb)), needsSecurity(callNeedsSecurity)
+        : Identifier{move(callName)}, nameCamelCase(camelCase(name))
+        , path(move(callPath)), verb(move(callVerb))
+        , needsSecurity(callNeedsSecurity)
     { }
     ~Call() = default;
     Call(Call&) = delete;
@@ -244,6 +331,7 @@ struct Call : Identifier {
     [[nodiscard]] params_type& getParamsBlock(const string& blockName);
     [[nodiscard]] params_type collateParams() const;
 
+    string nameCamelCase; ///< The operation id in CamelCase
     Path path;
     string verb;
     string summary;
@@ -287,16 +375,35 @@ struct Model {
     bool inlineMainSchema = false;
 
     imports_type imports;
+    /// All schemas in the order of adding; use addSchema() to add them
     schemas_type types;
 
     string hostAddress;
     string basePath;
     std::list<CallClass> callClasses;
 
+    /// The file the model has been loaded from
+    string srcPath;
+    /// Keys of the models (in Analyzer::allModels()) this model refers to
+    std::set<string> dependencies;
+    /// \brief Whether the analysis depended on the role beyond schema roles
+    ///
+    /// Such models cannot be reused for another role by only changing
+    /// the roles of their schemas, see Analyzer::loadDependency()
+    bool roleSensitive = false;
+    /// \brief Whether the model has been loaded before anything referred to it
+    ///
+    /// Such models are finished by the first reference to them, see
+    /// Analyzer::preloadDependency()
+    bool preloaded = false;
+
     void clear();
 
     Call& addCall(Path path, string verb, string operationId, bool needsToken);
+    /// Add the schema unless there's already one with that call and name
     void addSchema(ObjectSchema&& schema);
+    /// Rename a schema in `types`, keeping the index of schemas in sync
+    void renameSchema(ObjectSchema& schema, string newName);
     void addImportsFrom(const ObjectSchema& type);
     void addImportsFrom(const FlatSchema& type);
     void addImportsFrom(const TypeUsage& type);
@@ -310,6 +417,20 @@ struct Model {
         return callClasses.empty() &&
                 types.size() == 1 && types.front().trivial();
     }
+
+private:
+    friend class ModelSnapshot; // Restores the schemas along with the index
+
+    using schema_key_type = std::pair<const Call*, string>;
+    struct SchemaKeyHash {
+        size_t operator()(const schema_key_type& k) const
+        {
+            return std::hash<const Call*>()(k.first) * 31
+                   + std::hash<string>()(k.second);
+        }
+    };
+    /// Positions of schemas in `types` by their call and name
+    std::unordered_map<schema_key_type, size_t, SchemaKeyHash> _schemasIndex;
 };
 
 struct ModelException : Exception
@@ -18,11 +18,16 @@
 
 #include "printer.h"
 
+#include "logger.h"
+#include "profiler.h"
 #include "translator.h"
+#include "yaml.h"
 
 #include <algorithm>
+#include <chrono>
+#include <deque>
 #include <locale>
-#include <regex>
+#include <optional>
 
 using namespace std;
 using namespace std::placeholders;
@@ -63,51 +68,170 @@ inline Printer::template_type Printer::makeMustache(const string& tmpl) const
     return mstch;
 }
 
+Printer::template_type Printer::compiledTemplate(const string& tmpl) const
+{
+    {
+        const shared_lock l(_templatesMutex);
+        // Pointers to unordered_map elements survive rehashing
+        if (const auto it = _templates.find(tmpl); it != _templates.end())
+            return it->second;
+    }
+    const auto parseStart = chrono::steady_clock::now();
+    auto mstch = makeMustache(tmpl);
+    _parseNanoseconds +=
+        chrono::nanoseconds(chrono::steady_clock::now() - parseStart).count();
+    const lock_guard l(_templatesMutex);
+    return _templates.try_emplace(tmpl, move(mstch)).first->second;
+}
+
+/// \brief Add the names in the tags of \p tmpl to \p names
+///
+/// Follows delimiter changes; names of partials are added to \p partials
+/// instead. Compound names (`a.b`) are added by their parts.
+void collectTagNames(string_view tmpl, Printer::names_type& names,
+                     vector<string>& partials)
+{
+    constexpr auto npos = string_view::npos;
+    constexpr auto spaces = " \t\r\n";
+    const auto trimmed = [spaces](string_view s) {
+        const auto start = s.find_first_not_of(spaces);
+        return start == npos
+                   ? string_view()
+                   : s.substr(start, s.find_last_not_of(spaces) - start + 1);
+    };
+    string open = "{{", close = "}}";
+    for (size_t pos = 0;;) {
+        const auto tagStart = tmpl.find(open, pos);
+        if (tagStart == npos)
+            return;
+        const auto contentStart = tagStart + open.size();
+        auto contentEnd = tmpl.find(close, contentStart);
+        if (contentEnd == npos)
+            return;
+        pos = contentEnd + close.size();
+        auto content = tmpl.substr(contentStart, contentEnd - contentStart);
+        if (content.empty())
+            continue;
+        if (content.front() == '=' && content.size() > 1
+            && content.back() == '=') {
+            const auto delimiters = trimmed(content.substr(1, content.size() - 2));
+            const auto split = delimiters.find_first_of(spaces);
+            if (split != npos) {
+                open = string(delimiters.substr(0, split));
+                close = string(trimmed(delimiters.substr(split)));
+            }
+            continue;
+        }
+        const auto sigil = content.front();
+        if (sigil == '!')
+            continue;
+        if (sigil == '{' && pos < tmpl.size() && tmpl[pos] == '}')
+            ++pos; // {{{name}}}
+        if (string_view("#^/>&{").find(sigil) != npos)
+            content.remove_prefix(1);
+        const auto name = trimmed(content);
+        if (sigil == '>') {
+            partials.emplace_back(name);
+            continue;
+        }
+        for (size_t partStart = 0; partStart < name.size();) {
+            const auto partEnd = min(name.find('.', partStart), name.size());
+            if (partEnd > partStart)
+                names.emplace(name.substr(partStart, partEnd - partStart));
+            partStart = partEnd + 1;
+        }
+    }
+}
+
+const Printer::names_type& Printer::usedNames(const string& tmpl) const
+{
+    {
+        const shared_lock l(_usedNamesMutex);
+        if (const auto it = _usedNames.find(tmpl); it != _usedNames.end())
+            return it->second;
+    }
+    names_type names;
+    vector<string> partials;
+    collectTagNames(assignDelimiter(_delimiter, tmpl), names, partials);
+    // Partials are found the same way as GtadContext does it
+    for (unordered_set<string> visitedPartials; !partials.empty();) {
+        const auto partialName = move(partials.back());
+        partials.pop_back();
+        if (!visitedPartials.insert(partialName).second)
+            continue;
+        const km::data* partialData = _contextData.get(partialName);
+        if (!partialData)
+            try {
+                partialData = filePartial(partialName);
+            } catch (const Exception&) {
+                continue; // Rendering will report it, if it gets there
+            }
+        if (partialData && partialData->is_partial())
+            collectTagNames(partialData->partial_value()(), names, partials);
+    }
+    GTAD_DEBUG << "Templates use " << names.size() << " distinct name(s)";
+    const lock_guard l(_usedNamesMutex);
+    return _usedNames.try_emplace(tmpl, move(names)).first->second;
+}
+
 class GtadContext : public km::context<string>
 {
     public:
         using data = km::data;
 
-        GtadContext(Printer::fspath inputBasePath, string delimiter,
-                    const data* d)
-            : context(d)
-            , inputBasePath(move(inputBasePath))
-            , delimiter(move(delimiter))
+        /// The key that marks list items to be built by the item builder
+        static constexpr auto LazyItemKey = "_lazyItem";
+        using item_builder_type = function<object(size_t)>;
+
+        GtadContext(const Printer& printer, const data* d)
+            : context(d), printer(printer)
         {}
 
+        /// \brief Build list items marked with LazyItemKey on demand
+        ///
+        /// A section over such items gets each item made by \p builder
+        /// (from the index stored under LazyItemKey) as the section pushes it,
+        /// and destroyed as the section pops it; so only the payload for
+        /// the current item exists at any time.
+        void setItemBuilder(item_builder_type builder)
+        {
+            itemBuilder = move(builder);
+        }
+
+        void push(const data* d) override
+        {
+            auto& pushed = pushedItems.emplace_back();
+            if (itemBuilder && d->is_object())
+                if (const auto* index = d->get(LazyItemKey)) {
+                    auto item = itemBuilder(stoul(index->string_value()));
+                    // Keep the attributes setList() added to the item
+                    for (const auto* key: { "_join", "hasMore" })
+                        if (const auto* value = d->get(key))
+                            item.insert_or_assign(key, *value);
+                    d = &pushed.emplace(move(item));
+                }
+            context::push(d);
+        }
+
+        void pop() override
+        {
+            context::pop();
+            pushedItems.pop_back();
+        }
+
         const data* get_partial(const string& name) const override
         {
             if (const auto* result = context::get_partial(name))
                 return result;
 
-            auto it = filePartialsCache.find(name);
-            if (it != filePartialsCache.end())
-                return &it->second;
-
-            auto srcFileName = inputBasePath / name;
-            ifstream ifs { srcFileName };
-            if (!ifs.good())
-            {
-                srcFileName += ".mustache";
-                ifs.open(srcFileName);
-                if (!ifs.good())
-                    throw Exception("Failed to open file for a partial " + name
-                                    + ", tried "
-                                    + (inputBasePath / name).string() + " and "
-                                    + srcFileName.string());
-            }
-
-            string fileContents;
-            getline(ifs, fileContents, '\0'); // Won't work on files with NULs
-            return &filePartialsCache
-                        .emplace(name, makePartial(move(fileContents), delimiter))
-                        .first->second;
+            return printer.filePartial(name);
         }
 
     private:
-        Printer::fspath inputBasePath;
-        string delimiter;
-        mutable unordered_map<string, data> filePartialsCache;
+        const Printer& printer;
+        item_builder_type itemBuilder;
+        /// Items built for the pushed data, or nullopt for data pushed as is
+        std::deque<optional<data>> pushedItems;
 };
 
 template <typename StringT>
@@ -163,7 +287,8 @@ inline Printer::context_type addLibrary(Printer::context_type contextObj)
 }
 
 Printer::Printer(context_type&& contextObj, fspath inputBasePath,
-                 const fspath& outFilesListPath, string delimiter,
+                 const fspath& outFilesListPath,
+                 const fspath& emissionManifestPath, string delimiter,
                  const Translator& translator)
     : _translator(translator)
     , _contextData(addLibrary(contextObj))
@@ -178,10 +303,15 @@ Printer::Printer(context_type&& contextObj, fspath inputBasePath,
 {
     if (!outFilesListPath.empty())
     {
-        _outFilesList.open(_translator.outputBaseDir() / outFilesListPath);
-        if (!_outFilesList)
-            clog << "No out files list set or cannot write to the file" << endl;
+        _outFilesListPath = _translator.outputBaseDir() / outFilesListPath;
+        if (!ofstream(_outFilesListPath)) {
+            GTAD_WARNING << "No out files list set or cannot write to the file";
+            _outFilesListPath.clear();
+        }
     }
+    if (!emissionManifestPath.empty())
+        _emissionManifestPath =
+            _translator.outputBaseDir() / emissionManifestPath;
 }
 
 inline object wrap(object o)
@@ -228,17 +358,53 @@ void setList(ObjT& target, const string& name, const ContT& source)
 template <typename ModelT>
 void dumpDescription(object& target, const ModelT& model)
 {
-    vector<string> lines{};
-    if (!model.description.empty()) {
-        regex re{"\\n"};
-        lines = {sregex_token_iterator{model.description.cbegin(),
-                                       model.description.cend(), re, -1},
-                 sregex_token_iterator{}};
+    // Lines as views into the description, the same way as splitting it with
+    // a regex would make them: empty lines are kept, but not the one after
+    // the trailing line break
+    vector<string_view> lines;
+    for (string_view rest = model.description; !rest.empty();) {
+        const auto lineEnd = rest.find('\n');
+        lines.push_back(rest.substr(0, lineEnd));
+        if (lineEnd == string_view::npos)
+            break;
+        rest.remove_prefix(lineEnd + 1);
     }
-    setList(target, "description", lines);
+    setList(target, "description", lines,
+            [](string_view line) { return string(line); });
 }
 
-object Printer::renderType(const TypeUsage& tu) const
+/// Make a key covering everything in the type usage that renderType() uses
+void appendTypeKey(string& key, const TypeUsage& tu)
+{
+    key.append(tu.name).append(1, '\0').append(tu.baseName).append(1, '\0');
+    if (tu.call)
+        key.append(tu.call->name);
+    key.append(1, '<');
+    for (const auto& t: tu.paramTypes)
+        appendTypeKey(key, t);
+    key.append(1, '>');
+}
+
+const object& Printer::renderType(const TypeUsage& tu) const
+{
+    string key;
+    appendTypeKey(key, tu);
+    {
+        const shared_lock l(_renderedTypesMutex);
+        // Pointers to unordered_map elements survive rehashing
+        if (const auto it = _renderedTypes.find(key); it != _renderedTypes.end()) {
+            ++_renderedTypesHits;
+            return it->second;
+        }
+    }
+    // Rendering the same type twice in parallel makes the same result and
+    // only the first one is stored
+    auto mType = makeTypeObject(tu);
+    const lock_guard l(_renderedTypesMutex);
+    return _renderedTypes.try_emplace(move(key), move(mType)).first->second;
+}
+
+object Printer::makeTypeObject(const TypeUsage& tu) const
 {
     // This method first produces two contexts: one to render a non-qualified
     // name (in `values`), the other to do a qualified name
@@ -258,41 +424,42 @@ object Printer::renderType(const TypeUsage& tu) const
         // 2) we qualify types with call names, not calls (think of referring
         //    to another type within the same call)
         qualifiedValues.emplace("scope", tu.call->name);
-        qualifiedValues.emplace("scopeCamelCase", camelCase(tu.call->name));
+        qualifiedValues.emplace("scopeCamelCase", tu.call->nameCamelCase);
     }
 
-    // Fill parameters for parameterized types
-    setList(values, "types", tu.paramTypes,
-            bind(&Printer::renderType, this, _1));
-    setList(qualifiedValues, "types", tu.paramTypes,
-            bind(&Printer::renderType, this, _1));
-    int i = 0;
+    // Fill parameters for parameterized types, rendering each only once
+    vector<object> mParamTypes;
+    mParamTypes.reserve(tu.paramTypes.size());
     for (const auto& t: tu.paramTypes)
+        mParamTypes.push_back(renderType(t));
+    setList(values, "types", mParamTypes);
+    setList(qualifiedValues, "types", mParamTypes);
+    int i = 0;
+    for (auto& mParamType: mParamTypes)
     {
         // Substituting {{1}}, {{2}} and so on with actual inner type names
-        auto mParamType = renderType(t);
         values.emplace(to_string(++i), mParamType["name"]);
         qualifiedValues.emplace(to_string(i), mParamType["qualifiedName"]);
     }
 
-    GtadContext context {_inputBasePath, _delimiter, &_contextData};
-    return {{"name", renderWithOverlay(_typeRenderer, context, values)}
+    // Each render gets its own copy of the template: rendering records errors
+    // in the template object, and this is called from several threads
+    GtadContext context {*this, &_contextData};
+    return {{"name",
+             renderWithOverlay(template_type(_typeRenderer), context, values)}
            ,{"qualifiedName",
-             renderWithOverlay(_typeRenderer, context, qualifiedValues)}
+             renderWithOverlay(template_type(_typeRenderer), context,
+                               qualifiedValues)}
            ,{"baseName", tu.baseName}
            };
 }
 
 object Printer::dumpField(const VarDecl& field) const
 {
-    auto paramNameCamelCase = camelCase(field.name);
-    paramNameCamelCase.front() =
-        tolower(paramNameCamelCase.front(), locale::classic());
-
     object fieldDef { { "dataType",      renderType(field.type) }
                     , { "baseName",      field.baseName }
-                    , { "paramName",     paramNameCamelCase } // Swagger compat
-                    , { "nameCamelCase", paramNameCamelCase }
+                    , { "paramName",     field.nameCamelCase } // Swagger compat
+                    , { "nameCamelCase", field.nameCamelCase }
                       // TODO: nameSnakeCase
                     , { "required?",     field.required }
                     , { "required",      field.required } // Swagger compat
@@ -301,10 +468,10 @@ object Printer::dumpField(const VarDecl& field) const
     if (!field.defaultValue.empty())
         fieldDef.emplace("defaultValue", field.defaultValue);
 
-    for (const auto& attr: field.type.attributes)
+    for (const auto& attr: field.type.attributes())
         fieldDef.emplace(attr.first, partial {[v=attr.second] { return v; }});
 
-    for (const auto& listAttr: field.type.lists)
+    for (const auto& listAttr: field.type.lists())
     {
         km::list mAttrValue;
         for (const auto& i: listAttr.second)
@@ -320,12 +487,20 @@ void Printer::addList(object& target, const string& name,
     setList(target, name, properties, bind(&Printer::dumpField, this, _1));
 }
 
-object Printer::dumpAllTypes(const Model::schemas_type& types) const
+void Printer::addList(object& target, const string& name,
+                      const vector<const VarDecl*>& properties) const
+{
+    setList(target, name, properties,
+            [this](const VarDecl* v) { return dumpField(*v); });
+}
+
+object Printer::dumpAllTypes(const schema_ptrs_type& types) const
 {
     object mModels;
     setList(mModels, "model", types,
-        [this](const ObjectSchema& type)
+        [this](const ObjectSchema* pType)
         {
+            const auto& type = *pType;
             auto mType = renderType(TypeUsage(type));
             mType["classname"] = type.name; // Swagger compat
             dumpDescription(mType, type);
@@ -352,34 +527,52 @@ object Printer::dumpAllTypes(const Model::schemas_type& types) const
     return mModels;
 }
 
-object Printer::dumpTypes(const Model::schemas_type& types,
+object Printer::dumpTypes(const schema_ptrs_type& types,
                           const Call* scope) const
 {
-    Model::schemas_type selectedTypes;
+    schema_ptrs_type selectedTypes;
     copy_if(types.begin(), types.end(), back_inserter(selectedTypes),
-            [&](const ObjectSchema& s) { return s.call == scope; });
+            [&](const ObjectSchema* s) { return s->call == scope; });
     return dumpAllTypes(selectedTypes);
 }
 
-bool dumpContentTypes(object& target, const string& keyName, vector<string> types)
+bool hasNonJson(const vector<string>& types)
 {
-    setList(target, keyName, types);
-    const bool hasNonJson =
-        !all_of(types.begin(), types.end(),
-                [](const string& s) { return s.ends_with("/json"); });
-    target.emplace(keyName + "NonJson?", hasNonJson);
-    return hasNonJson;
+    return !all_of(types.begin(), types.end(),
+                   [](const string& s) { return s.ends_with("/json"); });
+}
+
+void dumpContentTypes(object& target, const string& keyName,
+                      const vector<string>& types, bool withList)
+{
+    if (withList)
+        setList(target, keyName, types);
+    target.emplace(keyName + "NonJson?", hasNonJson(types));
 }
 
 vector<string> Printer::print(const fspath& filePathBase,
                               const Model& model) const
 {
     if (model.empty()) {
-        clog << "Empty model, no files will be emitted" << endl;
+        GTAD_WARNING << "Empty model, no files will be emitted";
         return {};
     }
 
-    GtadContext context{_inputBasePath, _delimiter, &_contextData};
+    GtadContext context{*this, &_contextData};
+
+    // Only make the parts of the context that the templates may ask for;
+    // lists are looked up along with their "?"-suffixed flags
+    const auto outputs = _translator.outputConfig(filePathBase, model);
+    vector<const names_type*> namesPerTemplate;
+    for (const auto& output: outputs)
+        namesPerTemplate.push_back(&usedNames(output.second));
+    const auto used = [&namesPerTemplate](const string& name) {
+        return any_of(namesPerTemplate.begin(), namesPerTemplate.end(),
+                      [&name](const names_type* names) {
+                          return names->contains(name)
+                                 || names->contains(name + '?');
+                      });
+    };
 
     object payloadObj {{"filenameBase", filePathBase.filename().string()}
                       ,{"basePathWithoutHost", model.basePath}
@@ -388,39 +581,38 @@ vector<string> Printer::print(const fspath& filePathBase,
     setList(payloadObj, "imports", model.imports,
             [this, &context](const pair<string, string>& import) -> string {
                 if (import.first.empty() || import.second.empty()) {
-                    cerr << "Warning: empty import, the emitted code will "
-                            "likely be invalid"
-                         << endl;
+                    GTAD_WARNING << "Warning: empty import, the emitted code"
+                                    " will likely be invalid";
                     return {};
                 }
-                static unordered_map<string, template_type> tmplCache {};
-                const auto tmplIt =
-                    tmplCache
-                        .try_emplace(import.second, makeMustache(import.second))
-                        .first;
-
+                const auto importRenderer = compiledTemplate(import.second);
                 object importContextObj {{"_", import.first}};
                 setList(importContextObj, "segments", fspath(import.first));
                 // This is where the import as collected from the API
                 // description is actually transformed to the language-specific
                 // import target (such as a C++ header file)
-                return renderWithOverlay(tmplIt->second, context,
+                return renderWithOverlay(importRenderer, context,
                                          importContextObj);
             });
 
     // Unnamed schemas are only saved in the model to enable inlining
     // but cannot be used to emit valid code (not in C++ at least).
-    decltype(model.types) namedSchemas;
-    for (const auto& schema: model.types)
+    schema_ptrs_type namedSchemas;
+    // Schemas scoped to calls, bucketed in one pass over the model
+    unordered_map<const Call*, schema_ptrs_type> callSchemas;
+    for (const auto& schema: model.types) {
         if (!schema.name.empty())
-            namedSchemas.emplace_back(schema);
+            namedSchemas.push_back(&schema);
+        if (schema.call)
+            callSchemas[schema.call].push_back(&schema);
+    }
 
     if (model.inlineMainSchema)
         namedSchemas.pop_back();
 
-    auto&& mAllTypes = dumpAllTypes(namedSchemas); // Back-comp w/swagger
-    if (!mAllTypes.empty())
-        payloadObj.emplace("allModels", mAllTypes);
+    if (used("allModels")) // Back-comp w/swagger
+        if (auto&& mAllTypes = dumpAllTypes(namedSchemas); !mAllTypes.empty())
+            payloadObj.emplace("allModels", mAllTypes);
 
     auto&& mTypes = dumpTypes(namedSchemas);
     if (!mTypes.empty())
@@ -430,22 +622,38 @@ vector<string> Printer::print(const fspath& filePathBase,
     if (!model.callClasses.empty()) {
         const auto& callClass = model.callClasses.back();
         bool globalConsumesNonJson = false, globalProducesNonJson = false;
+        vector<const Call*> calls;
+        for (const auto& call: callClass.calls) {
+            calls.push_back(&call);
+            globalConsumesNonJson |= hasNonJson(call.consumedContentTypes);
+            globalProducesNonJson |= hasNonJson(call.producedContentTypes);
+        }
+        // The payload for each operation is only built while the templates
+        // render it (see GtadContext::setItemBuilder()), instead of having
+        // the payloads for the whole call class in memory
+        size_t callIndex = 0;
         // Any attributes should be added after setList
-        setList(mOperations, "operation", callClass.calls, [&](const Call& call) {
+        setList(mOperations, "operation", calls, [&callIndex](const Call*) {
+            return object { { GtadContext::LazyItemKey,
+                              to_string(callIndex++) } };
+        });
+        context.setItemBuilder([&](size_t index) {
+            const auto& call = *calls.at(index);
             // clang-format off
             object mCall { { "operationId", call.name }
-                         , { "camelCaseOperationId", camelCase(call.name) }
                          , { "httpMethod", call.verb }
                          , { "path", call.path }
                          , { "summary", call.summary }
                          , { "skipAuth", !call.needsSecurity } };
             // clang-format on
+            if (used("camelCaseOperationId"))
+                mCall.emplace("camelCaseOperationId", call.nameCamelCase);
             dumpDescription(mCall, call);
 
-            globalConsumesNonJson |=
-                dumpContentTypes(mCall, "consumes", call.consumedContentTypes);
-            globalProducesNonJson |=
-                dumpContentTypes(mCall, "produces", call.producedContentTypes);
+            dumpContentTypes(mCall, "consumes", call.consumedContentTypes,
+                             used("consumes"));
+            dumpContentTypes(mCall, "produces", call.producedContentTypes,
+                             used("produces"));
             mCall.emplace("producesImage?",
                           all_of(call.producedContentTypes.begin(),
                                  call.producedContentTypes.end(),
@@ -453,20 +661,31 @@ vector<string> Printer::print(const fspath& filePathBase,
                                      return s.starts_with("image/");
                                  }));
 
-            auto&& mCallTypes = dumpTypes(model.types, &call);
-            if (!mCallTypes.empty())
-                mCall.emplace("models", mCallTypes);
-            setList(mCall, "pathParts", call.path.parts,
-                    [this, &call](const Path::part_type& p) {
-                        const string s{call.path, get<0>(p), get<1>(p)};
-                        return get<2>(p) == Path::Variable ? s
-                               : _leftQuote + s + _rightQuote;
-                    });
-
-            addList(mCall, "allParams", call.collateParams());
+            if (const auto it = callSchemas.find(&call);
+                it != callSchemas.end())
+                if (auto&& mCallTypes = dumpAllTypes(it->second);
+                    !mCallTypes.empty())
+                    mCall.emplace("models", mCallTypes);
+            if (used("pathParts"))
+                setList(mCall, "pathParts", call.path.parts,
+                        [this, &call](const Path::part_type& p) {
+                            const auto part = call.path.partView(p);
+                            if (get<2>(p) == Path::Variable)
+                                return string(part);
+                            string s;
+                            s.reserve(_leftQuote.size() + part.size()
+                                      + _rightQuote.size());
+                            return s.append(_leftQuote)
+                                .append(part)
+                                .append(_rightQuote);
+                        });
+
+            if (used("allParams"))
+                addList(mCall, "allParams", call.collateParams());
             for (size_t i = 0; i < Call::ParamGroups.size(); ++i)
-                addList(mCall, Call::ParamGroups[i] + "Params",
-                        call.params[i]);
+                if (const auto& listName = Call::ParamGroups[i] + "Params";
+                    used(listName))
+                    addList(mCall, listName, call.params[i]);
 
             dispatchVisit(
                 call.body,
@@ -482,41 +701,46 @@ vector<string> Printer::print(const fspath& filePathBase,
                 [](monostate) {});
             mCall["hasBody?"] = !holds_alternative<monostate>(call.body);
 
-            setList(mCall, "responses", call.responses, [this](const Response& r) {
-                object mResponse{{"code", r.code},
-                                 {"normalResponse?", r.code == "200"}};
-
-                VarDecls allProperties;
-                copy(r.headers.begin(), r.headers.end(),
-                     back_inserter(allProperties));
-
-                dispatchVisit(
-                    r.body,
-                    [this, &mResponse,
-                     &allProperties](const FlatSchema& unpackedBody) {
-                        addList(mResponse, "properties", unpackedBody.fields);
-                        copy(unpackedBody.fields.begin(),
-                             unpackedBody.fields.end(),
-                             back_inserter(allProperties));
-                        if (unpackedBody.hasPropertyMap()) {
-                            allProperties.emplace_back(unpackedBody.propertyMap);
-                            mResponse["propertyMap"] =
-                                dumpField(unpackedBody.propertyMap);
-                        }
-                    },
-                    [this, &mResponse,
-                     &allProperties](const VarDecl& packedBody) {
-                        mResponse.emplace("inlineResponse",
-                                          dumpField(packedBody));
-                        allProperties.emplace_back(packedBody);
-                    },
-                    [](monostate) {});
-                for (const auto& src: {{"allProperties", allProperties},
-                                       pair{"headers", r.headers}})
-                    addList(mResponse, src.first, src.second);
-
-                return mResponse;
-            });
+            if (used("responses"))
+                setList(mCall, "responses", call.responses,
+                        [this, &used](const Response& r) {
+                    object mResponse{{"code", r.code},
+                                     {"normalResponse?", r.code == "200"}};
+
+                    // Pointers rather than copies; everything is in the model
+                    vector<const VarDecl*> allProperties;
+                    for (const auto& h: r.headers)
+                        allProperties.push_back(&h);
+
+                    dispatchVisit(
+                        r.body,
+                        [this, &used, &mResponse,
+                         &allProperties](const FlatSchema& unpackedBody) {
+                            if (used("properties"))
+                                addList(mResponse, "properties",
+                                        unpackedBody.fields);
+                            for (const auto& f: unpackedBody.fields)
+                                allProperties.push_back(&f);
+                            if (unpackedBody.hasPropertyMap()) {
+                                allProperties.push_back(&unpackedBody.propertyMap);
+                                mResponse["propertyMap"] =
+                                    dumpField(unpackedBody.propertyMap);
+                            }
+                        },
+                        [this, &mResponse,
+                         &allProperties](const VarDecl& packedBody) {
+                            mResponse.emplace("inlineResponse",
+                                              dumpField(packedBody));
+                            allProperties.push_back(&packedBody);
+                        },
+                        [](monostate) {});
+                    if (used("allProperties"))
+                        addList(mResponse, "allProperties", allProperties);
+                    if (used("headers"))
+                        addList(mResponse, "headers", r.headers);
+
+                    return mResponse;
+                });
 
             return mCall;
         });
@@ -530,29 +754,218 @@ vector<string> Printer::print(const fspath& filePathBase,
     }
     if (mTypes.empty() && mOperations.empty()) {
         if (!model.inlineMainSchema)
-            clog << "Warning: no emittable contents found in the model for "
-                 << filePathBase << ".*" << endl;
+            GTAD_WARNING
+                << "Warning: no emittable contents found in the model for "
+                << filePathBase << ".*";
         return {};
     }
 
     ContextOverlay overlay(context, payloadObj);
-    const auto outputs = _translator.outputConfig(filePathBase, model);
     vector<string> emittedFilenames;
     emittedFilenames.reserve(outputs.size());
     for (const auto& [fPath, fTemplate]: outputs) {
         const auto& fPathString = fPath.string();
-        ofstream ofs{fPath};
+        const Profiler::Scope profileScope { "render", fPathString };
+        GTAD_INFO << "Emitting " << fPathString;
+        auto fullTemplate = compiledTemplate(fTemplate);
+        const auto& stagedPath = stagingPath(fPath);
+        error_code ec;
+        filesystem::create_directories(stagedPath.parent_path(), ec);
+        ofstream ofs{stagedPath};
         if (!ofs.good())
-            throw Exception(fPathString + ": Couldn't open for writing");
-
-        cout << "Emitting " << fPathString << endl;
-        auto fullTemplate = makeMustache(fTemplate);
-        fullTemplate.render(context, ofs);
-        if (fullTemplate.error_message().empty()) {
-            _outFilesList << fPathString << endl;
-            emittedFilenames.push_back(fPathString);
-        } else
-            clog << fPath << ": " << fullTemplate.error_message() << endl;
+            throw Exception(stagedPath.string() + ": Couldn't open for writing");
+        // Stream the output into the file as it's rendered, instead of
+        // collecting the whole file in a string first
+        size_t bytesWritten = 0;
+        const auto renderStart = chrono::steady_clock::now();
+        fullTemplate.render(
+            [&ofs, &bytesWritten](const string& chunk) {
+                ofs.write(chunk.data(), streamsize(chunk.size()));
+                bytesWritten += chunk.size();
+            },
+            context);
+        _renderNanoseconds += chrono::nanoseconds(chrono::steady_clock::now()
+                                                  - renderStart)
+                                  .count();
+        ++_renderedFilesCount;
+        if (!fullTemplate.error_message().empty()) {
+            GTAD_WARNING << fPath << ": " << fullTemplate.error_message();
+            ofs.close();
+            filesystem::remove(stagedPath, ec); // Don't leave a partial file
+            continue;
+        }
+        if (!ofs.flush())
+            throw Exception(stagedPath.string() + ": Couldn't write the file");
+        Profiler::count(Profiler::FilesEmitted);
+        Profiler::count(Profiler::BytesEmitted, int64_t(bytesWritten));
+        emittedFilenames.push_back(fPathString);
     }
     return emittedFilenames;
 }
+
+Printer::fspath Printer::stagingPath(const fspath& fPath)
+{
+    // Keep the file name and the chain of parent directories intact so that
+    // clang-format finds the same configuration and the same main #include
+    return fPath.parent_path() / ".gtad.tmp" / fPath.filename();
+}
+
+void Printer::writeOutFilesList(const vector<string>& fileNames) const
+{
+    if (_outFilesListPath.empty())
+        return;
+    // Rewritten as a whole each time, as it's the list of all emitted files
+    string contents;
+    for (const auto& fName: fileNames)
+        (contents += fName) += '\n';
+    ofstream outFilesList { _outFilesListPath };
+    if (!outFilesList.write(contents.data(), streamsize(contents.size())))
+        GTAD_WARNING << "Warning: couldn't write the out files list to "
+                     << _outFilesListPath;
+}
+
+unordered_map<string, Printer::EmittedFile>
+loadEmissionManifest(const filesystem::path& filePath)
+{
+    unordered_map<string, Printer::EmittedFile> result;
+    if (!filesystem::exists(filePath))
+        return result;
+    try {
+        // JSON is a subset of YAML
+        for (const auto& fileYaml:
+             YamlMap::loadFromFile(filePath)["files"].asSequence()) {
+            const auto f = fileYaml.asMap();
+            auto fileName = f["file"].as<string>();
+            result.emplace(fileName,
+                           Printer::EmittedFile {
+                               fileName, f["model"].as<string>(),
+                               f["template"].as<string>(""), false,
+                               { f["size"].as<uintmax_t>(),
+                                 f["modified"].as<int64_t>(0),
+                                 f["hash"].as<string>() } });
+        }
+    } catch (Exception& e) {
+        GTAD_WARNING << "Warning: ignoring the invalid emission manifest at "
+                     << filePath << ": " << e.message;
+        result.clear();
+    } catch (YAML::Exception& e) {
+        GTAD_WARNING << "Warning: ignoring the invalid emission manifest at "
+                     << filePath << ": " << e.what();
+        result.clear();
+    }
+    return result;
+}
+
+void Printer::writeEmissionManifest(vector<EmittedFile> files) const
+{
+    if (_emissionManifestPath.empty())
+        return;
+    if (any_of(files.begin(), files.end(),
+               [](const EmittedFile& f) { return f.digest.hash.empty(); })) {
+        const auto previousFiles = loadEmissionManifest(_emissionManifestPath);
+        for (auto& f: files)
+            if (!f.digest.hash.empty())
+                continue;
+            else if (const auto it = previousFiles.find(f.fileName);
+                     it != previousFiles.end()
+                     && it->second.modelKey == f.modelKey) {
+                f.templateName = it->second.templateName;
+                // Only trust the previous digest if the file doesn't seem
+                // to have changed since
+                error_code ec;
+                const auto& previous = it->second.digest;
+                if (previous.modified != 0
+                    && previous.modified == modificationTicks(f.fileName)
+                    && previous.size == filesystem::file_size(f.fileName, ec)
+                    && !ec)
+                    f.digest = previous;
+                else
+                    f.digest = digestFile(f.fileName);
+            } else
+                f.digest = digestFile(f.fileName);
+    }
+    sort(files.begin(), files.end(),
+         [](const EmittedFile& f1, const EmittedFile& f2) {
+             return f1.fileName < f2.fileName;
+         });
+    string contents = "{\n  \"version\": 1,\n  \"files\": [";
+    const char* separator = "\n";
+    for (const auto& f: files) {
+        ((contents += separator) += "    {\"file\": ")
+            += toJsonString(f.fileName);
+        (contents += ", \"model\": ") += toJsonString(f.modelKey);
+        if (!f.templateName.empty())
+            (contents += ", \"template\": ") += toJsonString(f.templateName);
+        (contents += ", \"size\": ") += to_string(f.digest.size);
+        (contents += ", \"modified\": ") += to_string(f.digest.modified);
+        (contents += ", \"hash\": ") += toJsonString(f.digest.hash);
+        (contents += ", \"rewritten\": ") += f.rewritten ? "true" : "false";
+        contents += '}';
+        separator = ",\n";
+    }
+    contents += "\n  ]\n}\n";
+    ofstream ofs { _emissionManifestPath };
+    if (!ofs.write(contents.data(), streamsize(contents.size())))
+        throw Exception(_emissionManifestPath.string()
+                        + ": Couldn't write the emission manifest");
+}
+
+void Printer::dumpStatistics() const
+{
+    using fmilliseconds = chrono::duration<double, milli>;
+    const shared_lock l(_templatesMutex);
+    GTAD_DEBUG << "Templates: " << _templates.size() << " parsed in "
+               << fmilliseconds(chrono::nanoseconds(_parseNanoseconds)).count()
+               << " ms, " << _renderedFilesCount << " file(s) rendered in "
+               << fmilliseconds(chrono::nanoseconds(_renderNanoseconds)).count()
+               << " ms (summed across threads)";
+    const shared_lock rl(_renderedTypesMutex);
+    GTAD_DEBUG << "Type rendering cache: " << _renderedTypesHits << " hit(s), "
+               << _renderedTypes.size() << " miss(es)";
+}
+
+set<Printer::fspath> Printer::partialFiles() const
+{
+    const shared_lock l(_filePartialsMutex);
+    return _partialFiles;
+}
+
+const km::data* Printer::addFilePartial(const string& name,
+                                        const fspath& srcFileName) const
+{
+    ifstream ifs { srcFileName };
+    if (!ifs.good())
+        return nullptr;
+    string fileContents;
+    getline(ifs, fileContents, '\0'); // Won't work on files with NULs
+    Profiler::count(Profiler::PartialsLoaded);
+
+    const lock_guard l(_filePartialsMutex);
+    // Another thread might have loaded the same file in the meantime;
+    // emplace() keeps the first one but the result is the same anyway
+    const auto it =
+        _filePartials.emplace(name, makePartial(move(fileContents), _delimiter))
+            .first;
+    _partialFiles.insert(srcFileName);
+    return &it->second;
+}
+
+const km::data* Printer::filePartial(const string& name) const
+{
+    {
+        const shared_lock l(_filePartialsMutex);
+        // Pointers to unordered_map elements survive rehashing
+        if (const auto it = _filePartials.find(name); it != _filePartials.end())
+            return &it->second;
+    }
+
+    const auto basePath = _inputBasePath / name;
+    auto srcFileName = basePath;
+    srcFileName += ".mustache";
+    if (const auto* result = addFilePartial(name, basePath))
+        return result;
+    if (const auto* result = addFilePartial(name, srcFileName))
+        return result;
+    throw Exception("Failed to open file for a partial " + name + ", tried "
+                    + basePath.string() + " and " + srcFileName.string());
+}
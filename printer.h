@@ -4,8 +4,12 @@
 
 #include "mustache/mustache.hpp"
 
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
 
 class Translator;
 
@@ -20,17 +24,72 @@ public:
     using m_object_type = kainjow::mustache::object;
     using string = std::string;
     using fspath = std::filesystem::path;
+    using schema_ptrs_type = std::vector<const ObjectSchema*>;
 
     Printer(context_type&& contextObj, fspath inputBasePath,
-            const fspath& outFilesListPath, string delimiter,
-            const Translator& translator);
-    Printer(Printer&& p) = default;
+            const fspath& outFilesListPath, const fspath& emissionManifestPath,
+            string delimiter, const Translator& translator);
+    // The caches below are guarded by mutexes, hence neither copying
+    // nor moving; Translator holds its Printer by pointer
+    Printer(const Printer&) = delete;
+    Printer& operator=(const Printer&) = delete;
 
     Printer::template_type makeMustache(const string& tmpl) const;
+    /// \brief Get a copy of the parsed template for the text
+    ///
+    /// Templates are parsed once per run; each caller gets its own copy of
+    /// the parsed template to render from, since rendering records errors
+    /// in the template object (and marks it invalid for further renders).
+    template_type compiledTemplate(const string& tmpl) const;
+    using names_type = std::set<string, std::less<>>;
+    /// \brief Find all names used in the tags of the template
+    ///
+    /// Partials the template refers to are followed, so the result covers
+    /// everything that rendering the template can look up. Like parsed
+    /// templates, the results are kept for the Printer lifetime.
+    const names_type& usedNames(const string& tmpl) const;
+    /// \brief Emit files for the model
+    ///
+    /// The files are not written to their final location but to the one
+    /// returned by stagingPath(), to be compared with what's already there
+    /// after formatting. Can be called concurrently for different models.
+    /// \return the list of emitted files (their final paths)
     std::vector<std::string> print(const fspath& filePathBase,
                                    const Model& model) const;
+    static fspath stagingPath(const fspath& fPath);
+    void writeOutFilesList(const std::vector<std::string>& fileNames) const;
+    /// A file emitted from a model, for writeEmissionManifest()
+    struct EmittedFile {
+        string fileName;
+        string modelKey;
+        /// As given by Translator::outputTemplateName(); empty for the files
+        /// reused from the previous run
+        string templateName;
+        bool rewritten; ///< The file has been (re)written in this run
+        /// Empty for the files reused from the previous run
+        FileDigest digest {};
+    };
+    [[nodiscard]] bool hasEmissionManifest() const
+    {
+        return !_emissionManifestPath.empty();
+    }
+    /// \brief Write the emission manifest, if it's configured
+    ///
+    /// The manifest is a JSON object listing \p files, sorted by name, along
+    /// with their sizes and content hashes. The files reused from
+    /// the previous run take their details from the previous manifest (and
+    /// are only hashed if they are not there). Like the out files list,
+    /// the manifest is replaced as a whole, in a single write.
+    void writeEmissionManifest(std::vector<EmittedFile> files) const;
+    /// Files loaded so far to expand partials that are not in the config
+    [[nodiscard]] std::set<fspath> partialFiles() const;
+    /// Print the numbers of parsed templates and rendered files to clog
+    void dumpStatistics() const;
 
 private:
+    friend class GtadContext; // defined in printer.cpp
+    friend struct PrinterBenchmark; // defined in bench/gtad_bench.cpp
+
     const Translator& _translator;
     kainjow::mustache::data _contextData;
     string _delimiter;
@@ -38,13 +97,39 @@ private:
     string _leftQuote;
     string _rightQuote;
     fspath _inputBasePath;
-    mutable std::ofstream _outFilesList;
+    fspath _outFilesListPath;
+    fspath _emissionManifestPath;
+    /// Parsed templates (output files, imports) by their source
+    mutable std::unordered_map<string, template_type> _templates;
+    mutable std::shared_mutex _templatesMutex;
+    mutable std::atomic<std::int64_t> _parseNanoseconds = 0;
+    mutable std::atomic<std::int64_t> _renderNanoseconds = 0;
+    mutable std::atomic<size_t> _renderedFilesCount = 0;
+    /// Results of usedNames() by the template source
+    mutable std::unordered_map<string, names_type> _usedNames;
+    mutable std::shared_mutex _usedNamesMutex;
+    /// Rendered type names, keyed by everything renderType() depends on
+    mutable std::unordered_map<string, m_object_type> _renderedTypes;
+    mutable std::shared_mutex _renderedTypesMutex;
+    mutable std::atomic<size_t> _renderedTypesHits = 0;
+    /// Partials loaded from files, shared by all rendering contexts
+    mutable std::unordered_map<string, kainjow::mustache::data> _filePartials;
+    mutable std::set<fspath> _partialFiles;
+    mutable std::shared_mutex _filePartialsMutex;
 
-    [[nodiscard]] m_object_type renderType(const TypeUsage& tu) const;
+    /// Find a partial loaded from a file, loading it if necessary
+    const kainjow::mustache::data* filePartial(const string& name) const;
+    const kainjow::mustache::data* addFilePartial(
+        const string& name, const fspath& srcFileName) const;
+    /// Render the type names, or find them among those rendered before
+    [[nodiscard]] const m_object_type& renderType(const TypeUsage& tu) const;
+    [[nodiscard]] m_object_type makeTypeObject(const TypeUsage& tu) const;
     [[nodiscard]] m_object_type dumpField(const VarDecl& field) const;
     void addList(m_object_type& target, const string& name,
                  const VarDecls& properties) const;
-    [[nodiscard]] m_object_type dumpAllTypes(const Model::schemas_type& types) const;
-    [[nodiscard]] m_object_type dumpTypes(const Model::schemas_type& types,
+    void addList(m_object_type& target, const string& name,
+                 const std::vector<const VarDecl*>& properties) const;
+    [[nodiscard]] m_object_type dumpAllTypes(const schema_ptrs_type& types) const;
+    [[nodiscard]] m_object_type dumpTypes(const schema_ptrs_type& types,
                                           const Call* scope = {}) const;
 };
@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "profiler.h"
+
+#include "util.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using fmilliseconds = chrono::duration<double, milli>;
+
+atomic<bool> Profiler::_enabled = false;
+atomic<int64_t> Profiler::_counters[CountersSize] {};
+
+static const char* const counterNames[Profiler::CountersSize] {
+    "files loaded",  "bytes loaded",         "$refs resolved",
+    "mapType() calls", "mapType() cache hits", "partials loaded",
+    "files emitted", "bytes emitted"
+};
+
+struct Totals {
+    size_t calls = 0;
+    chrono::nanoseconds time {};
+};
+
+struct TraceEvent {
+    const char* stage;
+    string subject;
+    unsigned threadId;
+    chrono::steady_clock::time_point start;
+    chrono::nanoseconds duration;
+};
+
+static mutex profileMutex;
+static chrono::steady_clock::time_point profileStart;
+static bool recordingTrace = false;
+// Stage names are never copied, see Profiler::Scope
+static map<string_view, Totals> stageTotals;
+static map<pair<string_view, string>, Totals> subjectTotals;
+static vector<TraceEvent> traceEvents;
+
+static unsigned currentThreadId()
+{
+    static atomic<unsigned> nextThreadId = 1;
+    thread_local const unsigned threadId = nextThreadId++;
+    return threadId;
+}
+
+void Profiler::enable(bool recordTrace)
+{
+    const lock_guard l(profileMutex);
+    profileStart = chrono::steady_clock::now();
+    recordingTrace = recordTrace;
+    _enabled = true;
+}
+
+Profiler::Scope::Scope(const char* stage, string_view subject)
+{
+    if (!enabled())
+        return;
+    _stage = stage;
+    _subject = subject;
+    _start = chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+    if (!_stage)
+        return;
+    const auto duration = chrono::steady_clock::now() - _start;
+    const auto threadId = currentThreadId();
+    const lock_guard l(profileMutex);
+    auto& stageTotal = stageTotals[_stage];
+    ++stageTotal.calls;
+    stageTotal.time += duration;
+    if (!_subject.empty()) {
+        auto& subjectTotal = subjectTotals[{ _stage, _subject }];
+        ++subjectTotal.calls;
+        subjectTotal.time += duration;
+    }
+    if (recordingTrace)
+        traceEvents.push_back(
+            { _stage, move(_subject), threadId, _start, duration });
+}
+
+void Profiler::printSummary(ostream& os)
+{
+    constexpr size_t SlowestCount = 10;
+
+    const lock_guard l(profileMutex);
+    const auto flags = os.flags();
+    os << fixed << setprecision(1) << "Profile (wall clock: "
+       << fmilliseconds(chrono::steady_clock::now() - profileStart).count()
+       << " ms; stage times include nested stages and are summed across"
+          " threads)\n"
+       << left << setw(24) << "Stage" << right << setw(10) << "Calls"
+       << setw(14) << "Total, ms" << '\n';
+    for (const auto& [stage, totals]: stageTotals)
+        os << left << setw(24) << stage << right << setw(10) << totals.calls
+           << setw(14) << fmilliseconds(totals.time).count() << '\n';
+
+    vector<const decltype(subjectTotals)::value_type*> slowest;
+    slowest.reserve(subjectTotals.size());
+    for (const auto& p: subjectTotals)
+        slowest.push_back(&p);
+    const auto slowestEnd =
+        slowest.begin() + ptrdiff_t(min(SlowestCount, slowest.size()));
+    partial_sort(slowest.begin(), slowestEnd, slowest.end(),
+                 [](const auto* lhs, const auto* rhs) {
+                     return lhs->second.time > rhs->second.time;
+                 });
+    if (!slowest.empty())
+        os << "Slowest files:\n";
+    for (auto it = slowest.begin(); it != slowestEnd; ++it) {
+        const auto& [key, totals] = **it;
+        os << right << setw(12) << fmilliseconds(totals.time).count()
+           << " ms  " << left << setw(16) << key.first << key.second << '\n';
+    }
+
+    os << "Counters:\n";
+    for (size_t i = 0; i < CountersSize; ++i)
+        os << left << setw(24) << counterNames[i] << right << setw(10)
+           << _counters[i].load() << '\n';
+    os.flags(flags);
+    os.flush();
+}
+
+void Profiler::writeTrace(const filesystem::path& filePath)
+{
+    ofstream ofs { filePath };
+    if (!ofs.good())
+        throw Exception(filePath.string() + ": Couldn't open for writing");
+
+    using fmicroseconds = chrono::duration<double, micro>;
+    const lock_guard l(profileMutex);
+    ofs << fixed << setprecision(3) << "{\"traceEvents\":[";
+    const char* separator = "\n";
+    for (const auto& e: traceEvents) {
+        ofs << separator << "{\"name\":" << toJsonString(e.stage)
+            << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.threadId
+            << ",\"ts\":" << fmicroseconds(e.start - profileStart).count()
+            << ",\"dur\":" << fmicroseconds(e.duration).count();
+        if (!e.subject.empty())
+            ofs << ",\"args\":{\"file\":" << toJsonString(e.subject) << '}';
+        ofs << '}';
+        separator = ",\n";
+    }
+    ofs << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+/// \brief Timings and counters of the generator stages, collected per run
+///
+/// Until enable() is called, all the functions below only check a flag.
+/// Everything can be used from any thread.
+class Profiler {
+public:
+    enum Counter {
+        FilesLoaded,
+        BytesLoaded,
+        RefsResolved,
+        MapTypeCalls,
+        MapTypeCacheHits,
+        PartialsLoaded,
+        FilesEmitted,
+        BytesEmitted,
+        CountersSize
+    };
+
+    /// \brief Start collecting timings and counters
+    /// \param recordTrace keep every measured scope for writeTrace()
+    static void enable(bool recordTrace);
+    [[nodiscard]] static bool enabled()
+    {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+    static void count(Counter counter, std::int64_t n = 1)
+    {
+        if (enabled())
+            _counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /// \brief Measure the time spent until the end of the scope
+    ///
+    /// Scopes can be nested; the time of a scope includes the time of
+    /// the scopes inside it.
+    class Scope {
+    public:
+        /// \param stage the stage name; must outlive the profiler, as it's
+        ///        not copied (a string literal is the usual choice)
+        /// \param subject the file (or anything else) the stage works on
+        explicit Scope(const char* stage, std::string_view subject = {});
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* _stage = nullptr; ///< nullptr if the profiler is off
+        std::string _subject;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    /// Print the totals per stage, the slowest subjects and the counters
+    static void printSummary(std::ostream& os);
+    /// \brief Write the recorded scopes in Chrome trace event format
+    ///
+    /// The file can be opened in chrome://tracing or ui.perfetto.dev.
+    /// \throw Exception if the file cannot be written
+    static void writeTrace(const std::filesystem::path& filePath);
+
+private:
+    static std::atomic<bool> _enabled;
+    static std::atomic<std::int64_t> _counters[CountersSize];
+};
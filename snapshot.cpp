@@ -0,0 +1,613 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "snapshot.h"
+
+#include "logger.h"
+#include "translator.h"
+
+#include <fstream>
+
+#if __has_include(<sys/mman.h>)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = filesystem;
+
+// The format: the magic, the format version and the settings, followed by
+// entries with a model each; all numbers are LEB128-encoded and strings are
+// prefixed with their length. Bump the version whenever Model changes.
+constexpr string_view SnapshotMagic = "GTADSNAP";
+constexpr uint64_t SnapshotFormatVersion = 1;
+
+struct SnapshotException : Exception
+{
+    using Exception::Exception;
+};
+
+struct Encoder {
+    string& out;
+    /// Calls are stored by their (1-based) position in the model
+    unordered_map<const Call*, uint64_t> callIds {};
+
+    void putInt(uint64_t n)
+    {
+        for (; n >= 0x80; n >>= 7)
+            out.push_back(char((n & 0x7F) | 0x80));
+        out.push_back(char(n));
+    }
+    void putBool(bool b) { out.push_back(char(b)); }
+    void putStr(string_view s)
+    {
+        putInt(s.size());
+        out.append(s);
+    }
+    template <typename ContT, typename FnT>
+    void putRange(const ContT& items, const FnT& putItem)
+    {
+        putInt(items.size());
+        for (const auto& item: items)
+            putItem(item);
+    }
+    void putStrings(const auto& strings)
+    {
+        putRange(strings, [this](const string& s) { putStr(s); });
+    }
+
+    void putCall(const Call* call)
+    {
+        if (!call) {
+            putInt(0);
+            return;
+        }
+        const auto it = callIds.find(call);
+        if (it == callIds.end())
+            throw SnapshotException(
+                "Internal error: the model refers to a call from elsewhere");
+        putInt(it->second);
+    }
+    void put(const Identifier& id)
+    {
+        putStr(id.name);
+        putInt(id.role);
+        putCall(id.call);
+    }
+    void put(const TypeDefinition* td)
+    {
+        putBool(td != nullptr);
+        if (!td)
+            return;
+        putRange(td->attributes, [this](const auto& p) {
+            putStr(p.first);
+            putStr(p.second);
+        });
+        putRange(td->lists, [this](const auto& p) {
+            putStr(p.first);
+            putStrings(p.second);
+        });
+    }
+    void put(const TypeUsage& tu)
+    {
+        put(static_cast<const Identifier&>(tu));
+        putStr(tu.baseName);
+        put(tu.definition);
+        putRange(tu.paramTypes, [this](const TypeUsage& pt) { put(pt); });
+    }
+    void put(const VarDecl& v)
+    {
+        put(static_cast<const Identifier&>(v));
+        put(v.type);
+        putStr(v.baseName);
+        putStr(v.description);
+        putBool(v.required);
+        putStr(v.defaultValue);
+    }
+    void put(const VarDecls& vs)
+    {
+        putRange(vs, [this](const VarDecl& v) { put(v); });
+    }
+    void put(const FlatSchema& s)
+    {
+        put(static_cast<const Identifier&>(s));
+        put(s.fields);
+        put(s.propertyMap);
+    }
+    void put(const ObjectSchema& s)
+    {
+        put(static_cast<const FlatSchema&>(s));
+        putStr(s.description);
+        putRange(s.parentTypes, [this](const TypeUsage& pt) { put(pt); });
+    }
+    void put(const Body& body)
+    {
+        putInt(body.index());
+        dispatchVisit(
+            body, [](monostate) {},
+            [this](const FlatSchema& unpacked) { put(unpacked); },
+            [this](const VarDecl& packed) { put(packed); });
+    }
+    void putContents(const Call& call)
+    {
+        putStr(call.summary);
+        putStr(call.description);
+        putStr(call.externalDocs.description);
+        putStr(call.externalDocs.url);
+        for (const auto& paramsBlock: call.params)
+            put(paramsBlock);
+        put(call.body);
+        putStrings(call.producedContentTypes);
+        putStrings(call.consumedContentTypes);
+        putRange(call.responses, [this](const Response& r) {
+            putStr(r.code);
+            putStr(r.description);
+            put(r.headers);
+            put(r.body);
+        });
+    }
+    void put(const Model& model)
+    {
+        putStr(model.apiSpec);
+        putInt(uint64_t(model.apiSpecVersion));
+        putBool(model.inlineMainSchema);
+        putRange(model.imports, [this](const auto& p) {
+            putStr(p.first);
+            putStr(p.second);
+        });
+        putStr(model.hostAddress);
+        putStr(model.basePath);
+        putStr(model.srcPath);
+        putStrings(model.dependencies);
+        putBool(model.roleSensitive);
+
+        // Calls come before anything that can refer to them
+        putRange(model.callClasses, [this](const CallClass& cc) {
+            putRange(cc.calls, [this](const Call& call) {
+                callIds.emplace(&call, callIds.size() + 1);
+                put(static_cast<const Identifier&>(call));
+                putStr(call.path);
+                putRange(call.path.parts, [this](const Path::part_type& part) {
+                    putInt(get<0>(part));
+                    putInt(get<1>(part));
+                    putInt(get<2>(part));
+                });
+                putStr(call.verb);
+                putBool(call.needsSecurity);
+            });
+        });
+        for (const auto& cc: model.callClasses)
+            for (const auto& call: cc.calls)
+                putContents(call);
+        putRange(model.types, [this](const ObjectSchema& s) { put(s); });
+    }
+};
+
+struct Decoder {
+    string_view in;
+    const Translator* translator = nullptr;
+    vector<const Call*> calls {};
+
+    uint64_t getInt()
+    {
+        uint64_t n = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            if (in.empty())
+                throw SnapshotException("Unexpected end of the snapshot");
+            const auto byte = uint8_t(in.front());
+            in.remove_prefix(1);
+            n |= uint64_t(byte & 0x7F) << shift;
+            if (byte < 0x80)
+                return n;
+        }
+        throw SnapshotException("Malformed number in the snapshot");
+    }
+    bool getBool() { return getInt() != 0; }
+    string_view getStr()
+    {
+        const auto size = getInt();
+        if (size > in.size())
+            throw SnapshotException("Unexpected end of the snapshot");
+        const auto result = in.substr(0, size);
+        in.remove_prefix(size);
+        return result;
+    }
+    template <typename FnT>
+    void getRange(const FnT& getItem)
+    {
+        for (auto n = getInt(); n > 0; --n)
+            getItem();
+    }
+    template <typename ContT>
+    void getStrings(ContT& strings)
+    {
+        getRange([&] { strings.insert(strings.end(), string(getStr())); });
+    }
+
+    const Call* getCall()
+    {
+        const auto id = getInt();
+        if (id > calls.size())
+            throw SnapshotException("Invalid call reference in the snapshot");
+        return id == 0 ? nullptr : calls[id - 1];
+    }
+    void get(Identifier& id)
+    {
+        id.name = getStr();
+        const auto role = getInt();
+        if (role > OnlyOut)
+            throw SnapshotException("Invalid role in the snapshot");
+        id.role = InOut(role);
+        id.call = getCall();
+    }
+    const TypeDefinition* getDefinition()
+    {
+        if (!getBool())
+            return nullptr;
+        TypeDefinition td;
+        getRange([&] {
+            auto key = string(getStr());
+            td.attributes.insert_or_assign(move(key), string(getStr()));
+        });
+        getRange([&] {
+            auto& list = td.lists[string(getStr())];
+            getStrings(list);
+        });
+        return translator->internDefinition(move(td));
+    }
+    void get(TypeUsage& tu)
+    {
+        get(static_cast<Identifier&>(tu));
+        tu.baseName = getStr();
+        tu.definition = getDefinition();
+        getRange([&] { get(tu.paramTypes.emplace_back()); });
+    }
+    void get(VarDecl& v)
+    {
+        get(static_cast<Identifier&>(v));
+        get(v.type);
+        v.baseName = getStr();
+        v.description = getStr();
+        v.required = getBool();
+        v.defaultValue = getStr();
+        v.nameCamelCase = lowerCamelCase(v.name);
+    }
+    void get(VarDecls& vs)
+    {
+        getRange([&] {
+            VarDecl v;
+            get(v);
+            vs.append(move(v));
+        });
+    }
+    void get(FlatSchema& s)
+    {
+        get(static_cast<Identifier&>(s));
+        get(s.fields);
+        get(s.propertyMap);
+    }
+    void get(ObjectSchema& s)
+    {
+        get(static_cast<FlatSchema&>(s));
+        s.description = getStr();
+        getRange([&] { get(s.parentTypes.emplace_back()); });
+    }
+    void get(Body& body)
+    {
+        switch (getInt()) {
+        case 0:
+            body = monostate {};
+            return;
+        case 1:
+            get(body.emplace<FlatSchema>(InAndOut));
+            return;
+        case 2:
+            get(body.emplace<VarDecl>());
+            return;
+        default:
+            throw SnapshotException("Invalid body kind in the snapshot");
+        }
+    }
+    void getContents(Call& call)
+    {
+        call.summary = getStr();
+        call.description = getStr();
+        call.externalDocs.description = getStr();
+        call.externalDocs.url = getStr();
+        for (auto& paramsBlock: call.params)
+            get(paramsBlock);
+        get(call.body);
+        getStrings(call.producedContentTypes);
+        getStrings(call.consumedContentTypes);
+        getRange([&] {
+            auto code = string(getStr());
+            auto& response =
+                call.responses.emplace_back(move(code), string(getStr()));
+            get(response.headers);
+            get(response.body);
+        });
+    }
+    void get(Model& model, vector<ObjectSchema>& types)
+    {
+        model.apiSpec = getStr();
+        model.apiSpecVersion = int(getInt());
+        model.inlineMainSchema = getBool();
+        getRange([&] {
+            auto key = string(getStr());
+            model.imports.insert_or_assign(move(key), string(getStr()));
+        });
+        model.hostAddress = getStr();
+        model.basePath = getStr();
+        model.srcPath = getStr();
+        getStrings(model.dependencies);
+        model.roleSensitive = getBool();
+
+        vector<Call*> modelCalls;
+        getRange([&] {
+            auto& cc = model.callClasses.emplace_back();
+            getRange([&] {
+                Identifier id;
+                get(id);
+                const auto pathString = string(getStr());
+                Path path { pathString };
+                static_cast<string&>(path) = pathString;
+                path.parts.clear();
+                getRange([&] {
+                    const auto from = getInt();
+                    const auto to = getInt();
+                    const auto kind = getInt();
+                    path.parts.emplace_back(from, to, Path::PartKind(kind));
+                });
+                auto verb = string(getStr());
+                auto& call = cc.calls.emplace_back(move(path), move(verb),
+                                                   move(id.name), getBool());
+                call.role = id.role;
+                modelCalls.push_back(&call);
+                calls.push_back(&call);
+            });
+        });
+        for (auto* call: modelCalls)
+            getContents(*call);
+        getRange([&] {
+            Identifier id;
+            get(id);
+            auto& s = types.emplace_back(id.role, id.call);
+            s.name = move(id.name);
+            get(s.fields);
+            get(s.propertyMap);
+            s.description = getStr();
+            getRange([&] { get(s.parentTypes.emplace_back()); });
+        });
+        if (!in.empty())
+            throw SnapshotException("Unexpected data at the end of the model");
+    }
+};
+
+ModelSnapshot::ModelSnapshot(fspath filePath, string settings)
+    : _filePath(move(filePath)), _settings(move(settings))
+{
+    openFile();
+}
+
+ModelSnapshot::~ModelSnapshot() { closeFile(); }
+
+void ModelSnapshot::openFile()
+{
+#if __has_include(<sys/mman.h>)
+    if (const auto fd = ::open(_filePath.c_str(), O_RDONLY | O_CLOEXEC);
+        fd != -1) {
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+            if (auto* p = mmap(nullptr, size_t(st.st_size), PROT_READ,
+                               MAP_PRIVATE, fd, 0);
+                p != MAP_FAILED) {
+                _mapping = p;
+                _contents = { static_cast<const char*>(p), size_t(st.st_size) };
+            }
+        ::close(fd);
+    }
+#endif
+    if (!_mapping) {
+        ifstream ifs { _filePath, ios::binary };
+        if (!ifs.good())
+            return;
+        _fileData.assign(istreambuf_iterator<char>(ifs), {});
+        _contents = _fileData;
+    }
+
+    try {
+        Decoder d { _contents };
+        if (!_contents.starts_with(SnapshotMagic))
+            throw SnapshotException("Not a GTAD snapshot");
+        d.in.remove_prefix(SnapshotMagic.size());
+        if (d.getInt() != SnapshotFormatVersion || d.getStr() != _settings) {
+            GTAD_DEBUG << "The snapshot in " << _filePath
+                       << " has been made with different settings, ignoring it";
+            return;
+        }
+        d.getRange([&] {
+            auto& entry = _entries[string(d.getStr())];
+            d.getRange([&] {
+                auto path = string(d.getStr());
+                entry.inputs.insert_or_assign(move(path), string(d.getStr()));
+            });
+            d.getStrings(entry.dependencies);
+            entry.data = d.getStr();
+        });
+        GTAD_DEBUG << "Loaded the snapshot of " << _entries.size()
+                   << " model(s) from " << _filePath;
+    } catch (const SnapshotException& e) {
+        GTAD_WARNING << "Warning: ignoring " << _filePath << ": " << e.message;
+        _entries.clear();
+    }
+}
+
+void ModelSnapshot::closeFile()
+{
+    _entries.clear();
+#if __has_include(<sys/mman.h>)
+    if (_mapping)
+        munmap(_mapping, _contents.size());
+#endif
+    _mapping = nullptr;
+    _contents = {};
+    _fileData.clear();
+}
+
+const string& ModelSnapshot::currentHash(const string& filePath)
+{
+    auto it = _currentHashes.find(filePath);
+    if (it == _currentHashes.end())
+        it = _currentHashes.emplace(filePath, hashFile(filePath)).first;
+    return it->second;
+}
+
+bool ModelSnapshot::upToDate(const string& modelKey)
+{
+    vector<string> keysToVisit { modelKey };
+    unordered_set<string> visitedKeys;
+    while (!keysToVisit.empty()) {
+        const auto key = move(keysToVisit.back());
+        keysToVisit.pop_back();
+        if (!visitedKeys.insert(key).second)
+            continue;
+        const auto it = _entries.find(key);
+        if (it == _entries.end())
+            return false;
+        for (const auto& [filePath, hash]: it->second.inputs)
+            if (currentHash(filePath) != hash)
+                return false;
+        keysToVisit.insert(keysToVisit.end(), it->second.dependencies.begin(),
+                           it->second.dependencies.end());
+    }
+    return true;
+}
+
+const vector<string>& ModelSnapshot::dependencies(const string& modelKey) const
+{
+    static const vector<string> noDependencies;
+    const auto it = _entries.find(modelKey);
+    return it != _entries.end() ? it->second.dependencies : noDependencies;
+}
+
+void ModelSnapshot::restore(const string& modelKey, Model& model,
+                            const Translator& translator) const
+{
+    const auto it = _entries.find(modelKey);
+    if (it == _entries.end())
+        throw SnapshotException("No model for " + modelKey
+                                + " in the snapshot");
+    Decoder d { it->second.data, &translator };
+    vector<ObjectSchema> types;
+    d.get(model, types);
+    // Keep the first schema for each call and name in the index, as
+    // Model::renameSchema() does
+    for (auto& s: types) {
+        model._schemasIndex.try_emplace({ s.call, s.name }, model.types.size());
+        model.types.emplace_back(move(s));
+    }
+}
+
+void ModelSnapshot::save(const models_t& models)
+{
+    string out { SnapshotMagic };
+    Encoder header { out };
+    header.putInt(SnapshotFormatVersion);
+    header.putStr(_settings);
+
+    map<string, Entry> entries;
+    string modelsData;
+    vector<pair<string, size_t>> modelsPositions;
+    for (const auto& [key, model]: models) {
+        if (model.preloaded)
+            continue;
+        Entry entry;
+        vector<const Model*> closure { &model };
+        unordered_set<string> visitedKeys { key };
+        bool complete = true;
+        for (size_t i = 0; i < closure.size(); ++i) {
+            entry.inputs.emplace(closure[i]->srcPath,
+                                 currentHash(closure[i]->srcPath));
+            for (const auto& depKey: closure[i]->dependencies)
+                if (visitedKeys.insert(depKey).second) {
+                    const auto depIt = models.find(depKey);
+                    if (depIt == models.end()) {
+                        complete = false;
+                        break;
+                    }
+                    closure.push_back(&depIt->second);
+                }
+        }
+        if (!complete)
+            continue;
+        entry.dependencies.assign(model.dependencies.begin(),
+                                  model.dependencies.end());
+        const auto start = modelsData.size();
+        try {
+            Encoder { modelsData }.put(model);
+        } catch (const SnapshotException& e) {
+            GTAD_DEBUG << "Not saving " << key << " to the snapshot: "
+                       << e.message;
+            modelsData.resize(start);
+            continue;
+        }
+        modelsPositions.emplace_back(key, modelsData.size() - start);
+        entries.emplace(key, move(entry));
+    }
+    // Fix up the views only now, as modelsData moves around while growing
+    size_t pos = 0;
+    for (const auto& [key, size]: modelsPositions) {
+        entries[key].data = string_view(modelsData).substr(pos, size);
+        pos += size;
+    }
+    for (const auto& [key, entry]: _entries)
+        if (!models.contains(key) && upToDate(key))
+            entries.emplace(key, entry);
+
+    header.putRange(entries, [&header](const auto& p) {
+        const auto& [key, entry] = p;
+        header.putStr(key);
+        header.putRange(entry.inputs, [&header](const auto& input) {
+            header.putStr(input.first);
+            header.putStr(input.second);
+        });
+        header.putStrings(entry.dependencies);
+        header.putStr(entry.data);
+    });
+
+    const auto tmpPath = fspath(_filePath.string() + ".tmp");
+    {
+        ofstream ofs { tmpPath, ios::binary | ios::trunc };
+        ofs.write(out.data(), streamsize(out.size()));
+        if (!ofs.good()) {
+            GTAD_WARNING << "Warning: couldn't write the snapshot to "
+                         << tmpPath;
+            return;
+        }
+    }
+    closeFile();
+    error_code ec;
+    fs::rename(tmpPath, _filePath, ec);
+    if (ec)
+        GTAD_WARNING << "Warning: couldn't replace " << _filePath << ": "
+                     << ec.message();
+    openFile();
+    GTAD_DEBUG << "Saved " << entries.size() << " model(s) to the snapshot";
+}
@@ -0,0 +1,93 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "model.h"
+
+#include <filesystem>
+#include <map>
+
+class Translator;
+
+/// \brief Analyzed models saved between runs, to skip analyzing them again
+///
+/// The snapshot lives in the output directory, next to the dependency
+/// manifest, in a compact binary format. Each model is saved along with the
+/// hashes of the files it has been made from (its own source and the sources
+/// of all models it refers to, recursively) and is only restored if none of
+/// them has changed; if the settings of the run (including the configuration)
+/// are different, nothing is restored at all. Where possible, the file is
+/// mapped to memory and models are decoded right from the mapping.
+class ModelSnapshot
+{
+public:
+    using string = std::string;
+    using fspath = std::filesystem::path;
+    using models_t = std::unordered_map<string, Model>;
+
+    /// \brief Open the snapshot at \p filePath, if it's there
+    /// \param settings a string with anything else that affects the analysis;
+    ///        if it changes, the saved models are not restored
+    ModelSnapshot(fspath filePath, string settings);
+    ~ModelSnapshot();
+    ModelSnapshot(const ModelSnapshot&) = delete;
+    ModelSnapshot& operator=(const ModelSnapshot&) = delete;
+
+    /// \brief Check that \p modelKey can be restored
+    /// \return true if the model is saved, along with all models it refers
+    ///         to, and the files they have been made from are unchanged
+    [[nodiscard]] bool upToDate(const string& modelKey);
+    /// Keys of the models \p modelKey referred to when it was saved
+    [[nodiscard]] const std::vector<string>&
+    dependencies(const string& modelKey) const;
+    /// \brief Fill \p model with the saved model for \p modelKey
+    ///
+    /// Type definitions are interned by \p translator, as if the model were
+    /// analyzed with it.
+    void restore(const string& modelKey, Model& model,
+                 const Translator& translator) const;
+    /// Hash the files anew next time, as they may have changed since
+    void resetHashes() { _currentHashes.clear(); }
+    /// \brief Save \p models, replacing the file
+    ///
+    /// The models saved before that are not in \p models are kept as long
+    /// as they are still up to date.
+    void save(const models_t& models);
+
+private:
+    using hashes_t = std::map<string, string>;
+    struct Entry {
+        hashes_t inputs;
+        std::vector<string> dependencies;
+        std::string_view data;
+    };
+
+    fspath _filePath;
+    string _settings;
+    std::map<string, Entry> _entries;
+    std::unordered_map<string, string> _currentHashes;
+    /// The contents of the file, mapped to memory or read into _fileData
+    std::string_view _contents;
+    void* _mapping = nullptr;
+    string _fileData;
+
+    void openFile();
+    void closeFile();
+    [[nodiscard]] const string& currentHash(const string& filePath);
+};
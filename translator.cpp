@@ -18,7 +18,9 @@
 
 #include "translator.h"
 
+#include "logger.h"
 #include "printer.h"
+#include "profiler.h"
 
 #include "yaml.h"
 
@@ -26,7 +28,7 @@
 
 using namespace std;
 
-void addTypeAttributes(TypeUsage& typeUsage, const YamlMap& attributesMap)
+void addTypeAttributes(TypeDefinition& typeDef, const YamlMap& attributesMap)
 {
     for (const auto& attr: attributesMap)
     {
@@ -36,15 +38,15 @@ void addTypeAttributes(TypeUsage& typeUsage, const YamlMap& attributesMap)
         switch (attr.second.Type())
         {
             case YAML::NodeType::Null:
-                typeUsage.attributes.emplace(move(attrName), string{});
+                typeDef.attributes.emplace(move(attrName), string{});
                 break;
             case YAML::NodeType::Scalar:
-                typeUsage.attributes.emplace(move(attrName),
-                                             attr.second.as<string>());
+                typeDef.attributes.emplace(move(attrName),
+                                           attr.second.as<string>());
                 break;
             case YAML::NodeType::Sequence:
                 if (const auto& seq = attr.second.asSequence())
-                    typeUsage.lists.emplace(move(attrName), seq.asStrings());
+                    typeDef.lists.emplace(move(attrName), seq.asStrings());
                 break;
             default:
                 throw YamlException(attr.second, "Malformed attribute");
@@ -52,26 +54,22 @@ void addTypeAttributes(TypeUsage& typeUsage, const YamlMap& attributesMap)
     }
 }
 
-TypeUsage parseTargetType(const YamlNode& yamlTypeNode)
+TypeUsage parseTargetType(const YamlNode& yamlTypeNode,
+                          const YamlMap& commonAttributesYaml,
+                          const Translator& translator)
 {
     using YAML::NodeType;
-    if (yamlTypeNode.Type() == NodeType::Null)
-        return {};
+    string typeName;
+    TypeDefinition typeDef;
     if (yamlTypeNode.Type() == NodeType::Scalar)
-        return TypeUsage(yamlTypeNode.as<string>());
-
-    const auto yamlTypeMap = yamlTypeNode.asMap();
-    TypeUsage typeUsage { yamlTypeMap["type"].as<string>("") };
-    addTypeAttributes(typeUsage, yamlTypeMap);
-    return typeUsage;
-}
-
-TypeUsage parseTargetType(const YamlNode& yamlTypeNode,
-                          const YamlMap& commonAttributesYaml)
-{
-    auto tu = parseTargetType(yamlTypeNode);
-    addTypeAttributes(tu, commonAttributesYaml);
-    return tu;
+        typeName = yamlTypeNode.as<string>();
+    else if (yamlTypeNode.Type() != NodeType::Null) {
+        const auto yamlTypeMap = yamlTypeNode.asMap();
+        typeName = yamlTypeMap["type"].as<string>("");
+        addTypeAttributes(typeDef, yamlTypeMap);
+    }
+    addTypeAttributes(typeDef, commonAttributesYaml);
+    return TypeUsage(move(typeName), translator.internDefinition(move(typeDef)));
 }
 
 template <typename FnT>
@@ -122,21 +120,22 @@ auto parseEntries(const YamlSequence& entriesYaml, const FnT& inserter,
 }
 
 pair_vector_t<TypeUsage> parseTypeEntry(const YamlNode& targetTypeYaml,
-                                        const YamlMap& commonAttributesYaml = {})
+                                        const YamlMap& commonAttributesYaml,
+                                        const Translator& translator)
 {
     switch (targetTypeYaml.Type())
     {
         case YAML::NodeType::Scalar: // Use a type with no regard to format
         case YAML::NodeType::Map: // Same, with attributes for the target type
         {
-            return { { {},
-                       parseTargetType(targetTypeYaml, commonAttributesYaml) } };
+            return { { {}, parseTargetType(targetTypeYaml, commonAttributesYaml,
+                                           translator) } };
         }
         case YAML::NodeType::Sequence: // A list of formats for the type
         {
             pair_vector_t<TypeUsage> targetTypes;
             parseEntries(targetTypeYaml.asSequence(),
-                [&targetTypes](string formatName,
+                [&targetTypes, &translator](string formatName,
                     const YamlNode& typeYaml, const YamlMap& commonAttrsYaml)
                 {
                     if (formatName.empty())
@@ -148,7 +147,7 @@ pair_vector_t<TypeUsage> parseTypeEntry(const YamlNode& targetTypeYaml,
                         formatName.pop_back();
                     }
                     targetTypes.emplace_back(move(formatName),
-                        parseTargetType(typeYaml, commonAttrsYaml));
+                        parseTargetType(typeYaml, commonAttrsYaml, translator));
                 }, commonAttributesYaml);
             return targetTypes;
         }
@@ -164,14 +163,15 @@ pair_vector_t<string> loadStringMap(const YamlMap& yaml)
     {
         auto pattern = subst.first.as<string>();
         if (pattern.empty()) // [[unlikely]]
-            clog << subst.first.location()
-                 << ": warning: empty pattern in substitutions, skipping"
-                 << endl;
+            GTAD_WARNING << subst.first.location()
+                         << ": warning: empty pattern in substitutions,"
+                            " skipping";
         else if (pattern.size() > 1 && pattern.front() != '/'
                  && pattern.back() == '/') // [[unlikely]]
-            clog << subst.first.location()
-                 << ": warning: invalid regular expression, skipping" << endl
-                 << "(use a regex with \\/ to match strings beginning with /)";
+            GTAD_WARNING << subst.first.location()
+                         << ": warning: invalid regular expression, skipping\n"
+                            "(use a regex with \\/ to match strings beginning"
+                            " with /)";
         else
         {
             if (pattern.front() == '/' && pattern.back() == '/')
@@ -182,50 +182,90 @@ pair_vector_t<string> loadStringMap(const YamlMap& yaml)
     return stringMap;
 }
 
+void Translator::PatternIndex::addLiteral(const string& pattern, size_t pos)
+{
+    literals.try_emplace(pattern, pos); // Only the first occurrence matters
+}
+
+void Translator::PatternIndex::addRegex(const string& pattern, size_t pos)
+{
+    try {
+        regexes.emplace_back(pos, regex(++pattern.begin(), pattern.end()));
+    } catch (regex_error& e) {
+        throw Exception("Invalid regular expression " + pattern.substr(1)
+                        + ": " + e.what());
+    }
+}
+
+size_t Translator::PatternIndex::findLiteral(const string& s) const
+{
+    const auto it = literals.find(s);
+    return it != literals.end() ? it->second : npos;
+}
+
 Translator::Translator(const path& configFilePath, path outputDirPath,
                        Verbosity verbosity)
     : _verbosity(verbosity), _outputDirPath(move(outputDirPath))
 {
-    cout << "Using config file at " << configFilePath << endl;
+    GTAD_INFO << "Using config file at " << configFilePath;
     const auto configY = YamlMap::loadFromFile(configFilePath);
 
     const auto& analyzerYaml = configY["analyzer"].asMap();
-    _substitutions = loadStringMap(analyzerYaml["subst"].asMap());
+    // Substitutions are applied to every loaded file; compile them once
+    for (auto& [pattern, replacement]:
+         loadStringMap(analyzerYaml["subst"].asMap()))
+        _substitutions.emplace_back(pattern, move(replacement));
     _identifiers = loadStringMap(analyzerYaml["identifiers"].asMap());
+    for (size_t i = 0; i < _identifiers.size(); ++i)
+        if (const auto& pattn = _identifiers[i].first;
+            !pattn.empty() && pattn.front() == '/')
+            _identifiersIndex.addRegex(pattn, i);
+        else
+            _identifiersIndex.addLiteral(pattn, i);
 
     parseEntries(analyzerYaml["types"].asSequence(),
         [this](const string& name, const YamlNode& typeYaml,
                const YamlMap& commonAttrsYaml)
         {
             _typesMap.emplace_back(name,
-                parseTypeEntry(typeYaml, commonAttrsYaml));
+                parseTypeEntry(typeYaml, commonAttrsYaml, *this));
         });
+    // _typesMap is not changed after this point, so it's safe to point into it
+    for (const auto& [swType, swFormats]: _typesMap) {
+        auto& formatsIndex = _typesIndex[swType];
+        for (const auto& [swFormat, mappedType]: swFormats) {
+            const auto pos = formatsIndex.types.size();
+            formatsIndex.types.push_back(&mappedType);
+            formatsIndex.formats.addLiteral(swFormat, pos);
+            if (!swFormat.empty() && swFormat.front() == '/')
+                formatsIndex.formats.addRegex(swFormat, pos);
+        }
+    }
 
     if (_verbosity == Verbosity::Debug)
         for (const auto& t : _typesMap) {
-            clog << "Type " << t.first << ":" << endl;
+            GTAD_DEBUG << "Type " << t.first << ":";
             for (const auto& f : t.second) {
-                clog << "  Format " << (f.first.empty() ? "(none)" : f.first)
-                     << ":" << endl
-                     << "    mapped to "
-                     << (!f.second.name.empty() ? f.second.name : "(none)")
-                     << endl;
-
-                if (!f.second.attributes.empty()) {
-                    clog << "    attributes:" << endl;
-                    for (const auto& a : f.second.attributes)
-                        clog << "      " << a.first << " -> " << a.second
-                             << endl;
+                GTAD_DEBUG << "  Format "
+                           << (f.first.empty() ? "(none)" : f.first) << ":";
+                GTAD_DEBUG << "    mapped to "
+                           << (!f.second.name.empty() ? f.second.name
+                                                      : "(none)");
+
+                if (!f.second.attributes().empty()) {
+                    GTAD_DEBUG << "    attributes:";
+                    for (const auto& a : f.second.attributes())
+                        GTAD_DEBUG << "      " << a.first << " -> " << a.second;
                 } else
-                    clog << "    no attributes" << endl;
+                    GTAD_DEBUG << "    no attributes";
 
-                if (!f.second.lists.empty()) {
-                    clog << "    lists:" << endl;
-                    for (const auto& l : f.second.lists)
-                        clog << "      " << l.first
-                             << " (entries: " << l.second.size() << ")" << endl;
+                if (!f.second.lists().empty()) {
+                    GTAD_DEBUG << "    lists:";
+                    for (const auto& l : f.second.lists())
+                        GTAD_DEBUG << "      " << l.first
+                                   << " (entries: " << l.second.size() << ")";
                 } else
-                    clog << "    no lists" << endl;
+                    GTAD_DEBUG << "    no lists";
             }
         }
 
@@ -269,9 +309,14 @@ Translator::Translator(const path& configFilePath, path outputDirPath,
                       });
         }
 
-    _printer = make_unique<Printer>(move(env), configFilePath.parent_path(),
-                                    mustacheYaml["outFilesList"].as<string>(""),
-                                    delimiter, *this);
+    _printer = make_unique<Printer>(
+        move(env), configFilePath.parent_path(),
+        mustacheYaml["outFilesList"].as<string>(""),
+        mustacheYaml["emissionManifest"].as<string>(""), delimiter, *this);
+    // Parse the templates for the emitted files once and for all
+    for (const auto* templates: { &_dataTemplates, &_apiTemplates })
+        for (const auto& p: *templates)
+            (void)_printer->compiledTemplate(p.second);
 }
 
 Translator::~Translator() = default;
@@ -289,62 +334,144 @@ Translator::output_config_t Translator::outputConfig(const path& filePathBase,
     return result;
 }
 
-TypeUsage Translator::mapType(const string& swaggerType,
-                              const string& swaggerFormat,
-                              const string& baseName) const
+string Translator::outputTemplateName(const path& filePathBase,
+                                      const Model& model,
+                                      const string& fileName) const
+{
+    // See outputConfig() for how the file names are made
+    const auto fNameBase = (outputBaseDir() / filePathBase).string();
+    return (model.apiSpec == ApiSpec::JSONSchema ? "data/" : "api/")
+           + fileName.substr(min(fNameBase.size(), fileName.size()));
+}
+
+size_t Translator::TypeDefinitionHash::operator()(const TypeDefinition& td) const
+{
+    // Unordered maps have no defined order; hence an order-independent sum
+    const hash<string> h;
+    size_t result = 0;
+    for (const auto& [name, value]: td.attributes)
+        result += h(name) * 31 + h(value);
+    for (const auto& [name, values]: td.lists) {
+        auto listHash = h(name);
+        for (const auto& v: values)
+            listHash = listHash * 31 + h(v);
+        result += listHash;
+    }
+    return result;
+}
+
+const TypeDefinition* Translator::internDefinition(TypeDefinition&& td) const
+{
+    if (td.attributes.empty() && td.lists.empty())
+        return nullptr;
+    const lock_guard l(_typeDefinitionsMutex);
+    return &*_typeDefinitions.insert(move(td)).first;
+}
+
+void Translator::addImport(TypeUsage& tu, string importName) const
+{
+    auto typeDef = tu.definition ? *tu.definition : TypeDefinition {};
+    typeDef.lists["imports"].emplace_back(move(importName));
+    tu.definition = internDefinition(move(typeDef));
+}
+
+size_t Translator::TypeKeyHash::operator()(const key_view_t& k) const
+{
+    const hash<string_view> h;
+    auto result = h(get<0>(k));
+    for (const auto& sv: { get<1>(k), get<2>(k) })
+        result = result * 31 + h(sv);
+    return result;
+}
+
+const TypeUsage& Translator::mapType(const string& swaggerType,
+                                     const string& swaggerFormat,
+                                     const string& baseName) const
+{
+    Profiler::count(Profiler::MapTypeCalls);
+    const TypeKeyHash::key_view_t keyView { swaggerType, swaggerFormat,
+                                            baseName };
+    {
+        const shared_lock l(_typesCacheMutex);
+        if (const auto it = _typesCache.find(keyView); it != _typesCache.end()) {
+            ++_typesCacheHits;
+            Profiler::count(Profiler::MapTypeCacheHits);
+            return it->second;
+        }
+    }
+    // Elements of unordered_map are never moved around in memory, so
+    // references to them are safe to use after unlocking
+    auto&& tu = resolveType(swaggerType, swaggerFormat, baseName);
+    const lock_guard l(_typesCacheMutex);
+    return _typesCache
+        .try_emplace({ swaggerType, swaggerFormat, baseName }, move(tu))
+        .first->second;
+}
+
+TypeUsage Translator::resolveType(const string& swaggerType,
+                                  const string& swaggerFormat,
+                                  const string& baseName) const
 {
     TypeUsage tu;
-    for (const auto& [swType, swFormats]: _typesMap)
-        if (swType == swaggerType)
-            for (const auto& [swFormat, mappedType]: swFormats)
-            {
-                if (swFormat == swaggerFormat ||
-                    (!swFormat.empty() && swFormat.front() == '/' &&
-                     regex_search(swaggerFormat,
-                                  regex(++swFormat.begin(), swFormat.end()))))
-                {
-                    // FIXME (#22): a source of great inefficiency.
-                    // TypeUsage should become a handle to an instance of
-                    // a newly-made TypeDefinition type that would own all
-                    // the stuff TypeUsage now has, except paramTypes
-                    tu = mappedType;
-                    goto conclusion;
-                }
+    if (const auto it = _typesIndex.find(swaggerType); it != _typesIndex.end())
+    {
+        const auto& [types, formats] = it->second;
+        auto matchPos = formats.findLiteral(swaggerFormat);
+        for (const auto& [pos, re]: formats.regexes)
+            if (pos >= matchPos)
+                break;
+            else if (regex_search(swaggerFormat, re)) {
+                matchPos = pos;
+                break;
             }
-conclusion:
+        if (matchPos != PatternIndex::npos)
+            tu = *types[matchPos];
+    }
     // Fallback chain: baseName, swaggerFormat, swaggerType
     tu.baseName = baseName.empty()
                       ? swaggerFormat.empty() ? swaggerType : swaggerFormat
                       : baseName;
-    if (auto& renderer = tu.attributes["_importRenderer"]; renderer.empty())
-        renderer = "{{_}}"; // Just render the import as is
+    if (const auto rIt = tu.attributes().find("_importRenderer");
+        rIt == tu.attributes().end() || rIt->second.empty()) {
+        auto typeDef = tu.definition ? *tu.definition : TypeDefinition {};
+        typeDef.attributes["_importRenderer"] = "{{_}}"; // Render as is
+        tu.definition = internDefinition(move(typeDef));
+    }
     return tu;
 }
 
+void Translator::dumpStatistics() const
+{
+    GTAD_DEBUG << "Type mapping cache: " << _typesCacheHits << " hit(s), "
+               << _typesCache.size() << " miss(es)";
+    _printer->dumpStatistics();
+}
+
 string Translator::mapIdentifier(const string& baseName,
                                  const Identifier* scope, bool required) const
 {
     auto scopedName = scope ? scope->qualifiedName() : string();
     scopedName.append(1, '/').append(baseName);
     string newName = baseName;
-    for (const auto& entry: _identifiers)
-    {
-        const auto& pattn = entry.first;
-        if (!pattn.empty() && pattn.front() == '/') {
-            auto&& replaced = regex_replace(scopedName,
-                                            regex(++pattn.begin(), pattn.end()),
-                                            entry.second);
-            if (replaced != scopedName) {
-//                cout << "Regex replace: " << scopedName << " -> " << replaced
-//                     << endl;
-                newName = replaced;
-                break;
-            }
-        } else if (pattn == baseName || pattn == scopedName) {
-            newName = entry.second;
+    const auto& index = _identifiersIndex;
+    const auto literalPos =
+        min(index.findLiteral(baseName), index.findLiteral(scopedName));
+    bool replaced = false;
+    for (const auto& [pos, re]: index.regexes) {
+        if (pos >= literalPos)
+            break;
+        if (auto&& newScopedName = regex_replace(scopedName, re,
+                                                 _identifiers[pos].second);
+            newScopedName != scopedName) {
+//            cout << "Regex replace: " << scopedName << " -> "
+//                 << newScopedName << endl;
+            newName = move(newScopedName);
+            replaced = true;
             break;
         }
     }
+    if (!replaced && literalPos != PatternIndex::npos)
+        newName = _identifiers[literalPos].second;
     if (newName.empty() && required)
         throw Exception(
             "Attempt to skip the required variable '" + baseName
@@ -18,15 +18,17 @@
 
 #pragma once
 
+#include "logger.h"
 #include "model.h"
 
+#include <atomic>
 #include <filesystem>
 #include <memory>
+#include <regex>
+#include <shared_mutex>
 
 class Printer;
 
-enum class Verbosity { Quiet = 0, Basic, Debug };
-
 class Translator
 {
 public:
@@ -38,7 +40,7 @@ public:
                Verbosity verbosity);
     ~Translator();
 
-    [[nodiscard]] const pair_vector_t<string>& substitutions() const
+    [[nodiscard]] const substitutions_t& substitutions() const
     {
         return _substitutions;
     }
@@ -47,22 +49,92 @@ public:
 
     [[nodiscard]] output_config_t outputConfig(const path& filePathBase,
                                                const Model& model) const;
-    [[nodiscard]] TypeUsage mapType(const string& swaggerType,
-                                    const string& swaggerFormat = {},
-                                    const string& baseName = {}) const;
+    /// \brief The configuration key of the template \p fileName is made from
+    ///
+    /// \p fileName is one of the files outputConfig() gives for
+    /// \p filePathBase and \p model; the result is the section and the file
+    /// extension under `templates`, e.g. `data/.h` or `api/.cpp`.
+    [[nodiscard]] string outputTemplateName(const path& filePathBase,
+                                            const Model& model,
+                                            const string& fileName) const;
+    /// \brief Find the target type for a given Swagger type and format
+    ///
+    /// The result is cached: the returned reference stays valid for
+    /// the lifetime of the translator, and the same arguments always yield
+    /// the same object. Make a copy if the type usage has to be modified.
+    [[nodiscard]] const TypeUsage& mapType(const string& swaggerType,
+                                           const string& swaggerFormat = {},
+                                           const string& baseName = {}) const;
     [[nodiscard]] string mapIdentifier(const string& baseName,
                                        const Identifier* scope,
                                        bool required) const;
 
+    /// \brief Get the shared instance of a type definition
+    ///
+    /// Equal definitions always yield the same pointer that stays valid
+    /// for the lifetime of the translator; empty definitions yield nullptr.
+    [[nodiscard]] const TypeDefinition*
+    internDefinition(TypeDefinition&& td) const;
+    /// Replace the definition of \p tu with one that has an extra import
+    void addImport(TypeUsage& tu, string importName) const;
+
+    void dumpStatistics() const;
+
 private:
+    /// \brief A precompiled index over an ordered list of patterns
+    ///
+    /// Literal patterns are looked up by hash; regular expressions are
+    /// compiled once and only tried if they come before the first literal
+    /// match, so that the result is the same as walking the original list.
+    struct PatternIndex {
+        static constexpr auto npos = std::string::npos;
+
+        std::unordered_map<string, size_t> literals;
+        std::vector<std::pair<size_t, std::regex>> regexes;
+
+        void addLiteral(const string& pattern, size_t pos);
+        void addRegex(const string& pattern, size_t pos);
+        [[nodiscard]] size_t findLiteral(const string& s) const;
+    };
+    struct FormatsIndex {
+        std::vector<const TypeUsage*> types;
+        PatternIndex formats;
+    };
+    struct TypeDefinitionHash {
+        size_t operator()(const TypeDefinition& td) const;
+    };
+    /// (swaggerType, swaggerFormat, baseName) -> the result of mapType()
+    using type_key_t = std::tuple<string, string, string>;
+    struct TypeKeyHash {
+        using is_transparent = void;
+        using key_view_t =
+            std::tuple<std::string_view, std::string_view, std::string_view>;
+        size_t operator()(const key_view_t& k) const;
+    };
+    using types_cache_t = std::unordered_map<type_key_t, TypeUsage, TypeKeyHash,
+                                             std::equal_to<>>;
+
     Verbosity _verbosity;
-    pair_vector_t<string> _substitutions;
+    substitutions_t _substitutions;
     pair_vector_t<string> _identifiers;
+    PatternIndex _identifiersIndex;
+    mutable std::unordered_set<TypeDefinition, TypeDefinitionHash>
+        _typeDefinitions;
+    mutable std::mutex _typeDefinitionsMutex;
     /// In JSON/YAML, the below looks like:
     /// <swaggerType>: { <swaggerFormat>: <TypeUsage>, ... }, ...
     pair_vector_t<pair_vector_t<TypeUsage>> _typesMap;
+    /// Formats for each Swagger type from _typesMap, in the order of definition
+    std::unordered_map<string, FormatsIndex> _typesIndex;
+    mutable types_cache_t _typesCache;
+    mutable std::shared_mutex _typesCacheMutex;
+    mutable std::atomic<size_t> _typesCacheHits = 0;
     /// Mapping of file extensions to mustache templates
     pair_vector_t<string> _dataTemplates, _apiTemplates;
     path _outputDirPath;
     std::unique_ptr<Printer> _printer;
+
+    [[nodiscard]] TypeUsage resolveType(const string& swaggerType,
+                                        const string& swaggerFormat,
+                                        const string& baseName) const;
 };
@@ -18,8 +18,17 @@
 
 #include "util.h"
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+
+#if __has_include(<sys/mman.h>)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
 
 std::string readFile(const std::string& fileName)
 {
@@ -35,3 +44,187 @@ std::string readFile(const std::string& fileName)
     getline(ifs, result, '\0'); // Won't work on files with NULs
     return result;
 }
+
+FileContents::FileContents(const std::filesystem::path& filePath)
+{
+#if __has_include(<sys/mman.h>)
+    if (const auto fd = open(filePath.c_str(), O_RDONLY); fd != -1) {
+        struct stat st {};
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            const auto size = static_cast<size_t>(st.st_size);
+            if (auto* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                p != MAP_FAILED) {
+                _mapping = p;
+                _view = { static_cast<const char*>(p), size };
+            }
+        }
+        close(fd);
+        if (_mapping)
+            return;
+    }
+#endif
+    std::ifstream ifs { filePath, std::ios::binary };
+    if (!ifs.good())
+        throw Exception("Failed to open file: " + filePath.string());
+    _buffer.assign(std::istreambuf_iterator<char>(ifs),
+                   std::istreambuf_iterator<char>());
+    _view = _buffer;
+}
+
+FileContents::~FileContents()
+{
+#if __has_include(<sys/mman.h>)
+    if (_mapping)
+        munmap(_mapping, _view.size());
+#endif
+}
+
+std::string findLiteralPrefix(const std::string& pattern)
+{
+    // Alternatives can start with anything
+    if (pattern.find('|') != std::string::npos)
+        return {};
+    static constexpr std::string_view specialChars = "\\^$.?*+()[]{}";
+    const auto prefixEnd = std::min(pattern.find_first_of(specialChars),
+                                    pattern.size());
+    auto prefix = pattern.substr(0, prefixEnd);
+    // The last character is optional if a quantifier allowing zero follows
+    if (!prefix.empty() && prefixEnd < pattern.size()
+        && std::string_view("?*{").find(pattern[prefixEnd])
+               != std::string_view::npos)
+        prefix.pop_back();
+    return prefix;
+}
+
+Substitution::Substitution(const std::string& pattern, std::string replacement)
+    : pattern(pattern)
+    , replacement(move(replacement))
+    , literalPrefix(findLiteralPrefix(pattern))
+{
+    try {
+        regex.assign(pattern);
+    } catch (std::regex_error& e) {
+        throw Exception("Invalid regular expression " + pattern + ": "
+                        + e.what());
+    }
+}
+
+std::string_view applySubstitutions(std::string_view source,
+                                    const substitutions_t& substitutions,
+                                    std::string& buffer)
+{
+    auto current = source;
+    std::string result;
+    for (const auto& subst: substitutions) {
+        if (!subst.literalPrefix.empty()
+            && current.find(subst.literalPrefix) == std::string_view::npos)
+            continue;
+        result.clear();
+        result.reserve(current.size());
+        std::regex_replace(back_inserter(result), current.begin(),
+                           current.end(), subst.regex, subst.replacement);
+        // The previous result is no more needed, reuse its memory
+        buffer.swap(result);
+        current = buffer;
+    }
+    return current;
+}
+
+std::string hashString(std::string_view data)
+{
+    // FNV-1a
+    std::uint64_t h = 0xcbf29ce484222325u;
+    for (const auto c: data) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3u;
+    }
+    static constexpr auto digits = "0123456789abcdef";
+    std::string result(16, '0');
+    for (auto it = result.rbegin(); it != result.rend(); ++it, h >>= 4)
+        *it = digits[h & 0xf];
+    return result;
+}
+
+std::string hashFile(const std::filesystem::path& filePath)
+{
+    try {
+        return hashString(FileContents(filePath).view());
+    } catch (const Exception&) {
+        return {};
+    }
+}
+
+std::int64_t modificationTicks(const std::filesystem::path& filePath)
+{
+    std::error_code ec;
+    const auto modified = std::filesystem::last_write_time(filePath, ec);
+    return ec ? 0 : std::int64_t(modified.time_since_epoch().count());
+}
+
+FileDigest digestFile(const std::filesystem::path& filePath)
+{
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(filePath, ec);
+    return { ec ? 0 : size, modificationTicks(filePath), hashFile(filePath) };
+}
+
+std::string toJsonString(std::string_view s)
+{
+    std::string result;
+    result.reserve(s.size() + 2);
+    result.push_back('"');
+    for (const auto c: s)
+        switch (c) {
+        case '"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\n': result += "\\n"; break;
+        case '\r': result += "\\r"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                static constexpr auto digits = "0123456789abcdef";
+                result += "\\u00";
+                result.push_back(digits[c >> 4]);
+                result.push_back(digits[c & 0xf]);
+            } else
+                result.push_back(c);
+        }
+    result.push_back('"');
+    return result;
+}
+
+bool replaceIfChanged(const std::filesystem::path& source,
+                      const std::filesystem::path& target, FileDigest* digest)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const auto sourceSize = fs::file_size(source);
+    const auto targetSize = fs::file_size(target, ec);
+    const auto sameSize = !ec && targetSize == sourceSize;
+    if (sameSize || digest) {
+        // Compare the whole contents, NULs included
+        bool sameContents = false;
+        {
+            const FileContents contents { source };
+            if (digest)
+                *digest = { sourceSize, 0, hashString(contents.view()) };
+            if (sameSize)
+                try {
+                    sameContents =
+                        contents.view() == FileContents(target).view();
+                } catch (const Exception&) {
+                    // Can't read the target; overwrite it
+                }
+        }
+        if (sameContents) {
+            fs::remove(source);
+            if (digest)
+                digest->modified = modificationTicks(target);
+            return false;
+        }
+    }
+    fs::rename(source, target);
+    if (digest)
+        digest->modified = modificationTicks(target);
+    return true;
+}
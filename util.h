@@ -18,14 +18,99 @@
 
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <regex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 template <typename T>
 using pair_vector_t = std::vector<std::pair<std::string, T>>;
 
 std::string readFile(const std::string& fileName);
 
+/// \brief Read-only contents of a file, memory-mapped where possible
+///
+/// Falls back to reading the file into memory on systems without mmap()
+/// or if mapping fails.
+class FileContents {
+public:
+    /// \throw Exception if the file cannot be opened
+    explicit FileContents(const std::filesystem::path& filePath);
+    ~FileContents();
+    FileContents(const FileContents&) = delete;
+    FileContents& operator=(const FileContents&) = delete;
+
+    [[nodiscard]] std::string_view view() const { return _view; }
+
+private:
+    void* _mapping = nullptr;
+    std::string _buffer;
+    std::string_view _view;
+};
+
+/// \brief A regular expression replacement, compiled once for all files
+struct Substitution {
+    /// \throw Exception if \p pattern is not a valid regular expression
+    Substitution(const std::string& pattern, std::string replacement);
+
+    std::string pattern;
+    std::regex regex;
+    std::string replacement;
+    /// \brief The literal text every match starts with, if known
+    ///
+    /// Allows to skip the substitution without running the regex
+    /// if the text is not found in the input.
+    std::string literalPrefix;
+};
+using substitutions_t = std::vector<Substitution>;
+
+/// \brief Apply substitutions to \p source, one after another
+///
+/// Each substitution works on the result of the previous ones.
+/// \return a view of \p source itself if no substitution could match,
+///         or of \p buffer where the result has been put otherwise
+std::string_view applySubstitutions(std::string_view source,
+                                    const substitutions_t& substitutions,
+                                    std::string& buffer);
+
+/// A (non-cryptographic) 64-bit hash of the data, as a hex string
+std::string hashString(std::string_view data);
+/// hashString() of the file contents; empty if the file cannot be read
+std::string hashFile(const std::filesystem::path& filePath);
+
+/// Quote and escape the string to use it in JSON (or YAML) output
+std::string toJsonString(std::string_view s);
+
+/// The size, the modification time and the hashString() of a file's contents
+struct FileDigest {
+    std::uintmax_t size = 0;
+    /// filesystem::last_write_time() of the file, in the ticks of its clock
+    std::int64_t modified = 0;
+    std::string hash;
+};
+/// FileDigest of the file; the hash is empty if the file cannot be read
+FileDigest digestFile(const std::filesystem::path& filePath);
+/// filesystem::last_write_time() in the ticks of its clock; 0 on errors
+std::int64_t modificationTicks(const std::filesystem::path& filePath);
+
+/// \brief Move \p source over \p target unless their contents are the same
+///
+/// If the contents are the same, \p source is removed and \p target is left
+/// untouched (along with its modification time).
+/// \param digest if not null, receives the digest of \p source contents,
+///        taken while the file is read for comparison anyway
+/// \return whether \p target has been (re)written
+bool replaceIfChanged(const std::filesystem::path& source,
+                      const std::filesystem::path& target,
+                      FileDigest* digest = nullptr);
+
 struct Exception
 {
     explicit Exception(std::string msg) noexcept : message(move(msg)) { }
@@ -33,3 +118,43 @@ struct Exception
     Exception& operator=(Exception&&) = delete;
     std::string message;
 };
+
+/// \brief Invoke \p fn on each element of \p items using up to \p jobs threads
+///
+/// With a single job the elements are processed in order in the calling
+/// thread. Otherwise the order is unspecified; once \p fn throws, no more
+/// elements are picked up and the exception is rethrown after all threads
+/// are done. \p ContT must provide random access to its elements.
+template <typename ContT, typename FnT>
+void forEachParallel(ContT& items, unsigned jobs, const FnT& fn)
+{
+    if (jobs <= 1 || items.size() <= 1) {
+        for (auto& item: items)
+            fn(item);
+        return;
+    }
+    std::atomic<size_t> nextIdx = 0;
+    std::exception_ptr eptr;
+    std::mutex eptrMutex;
+    auto worker = [&] {
+        for (auto i = nextIdx++; i < items.size(); i = nextIdx++)
+            try {
+                fn(items[i]);
+            } catch (...) {
+                const std::lock_guard l(eptrMutex);
+                if (!eptr)
+                    eptr = std::current_exception();
+                nextIdx = items.size(); // Don't start anything else
+            }
+    };
+    const auto threadsCount = std::min<size_t>(jobs, items.size()) - 1;
+    std::vector<std::thread> threads;
+    threads.reserve(threadsCount);
+    while (threads.size() < threadsCount)
+        threads.emplace_back(worker);
+    worker(); // The calling thread is one of the workers
+    for (auto& t: threads)
+        t.join();
+    if (eptr)
+        std::rethrow_exception(eptr);
+}
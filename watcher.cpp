@@ -0,0 +1,163 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "watcher.h"
+
+#include <thread>
+
+#if __has_include(<sys/inotify.h>)
+#    include <poll.h>
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+using namespace std;
+namespace fs = filesystem;
+
+/// \brief How often files are checked
+///
+/// Without inotify, this is the only way to find changes; with it, this
+/// still catches the files inotify misses, such as those in directories
+/// that could not be watched or have been replaced since.
+constexpr int PollingIntervalMs = 300;
+/// How long to wait for more changes after the first one
+constexpr int SettleTimeMs = 100;
+
+FileWatcher::FileWatcher()
+{
+#if __has_include(<sys/inotify.h>)
+    _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#if __has_include(<sys/inotify.h>)
+    if (_inotifyFd != -1)
+        close(_inotifyFd);
+#endif
+}
+
+FileWatcher::FileState FileWatcher::currentState(const fspath& path)
+{
+    error_code ec;
+    const auto modificationTime = fs::last_write_time(path, ec);
+    if (ec) // The file is gone
+        return { fs::file_time_type::min(), 0 };
+    const auto size = fs::is_directory(path, ec) ? 0 : fs::file_size(path, ec);
+    return { modificationTime, ec ? 0 : size };
+}
+
+void FileWatcher::watch(const set<fspath>& paths)
+{
+    _files.clear();
+    for (const auto& p: paths)
+        _files.emplace(p, currentState(p));
+
+#if __has_include(<sys/inotify.h>)
+    if (_inotifyFd == -1)
+        return;
+    // Watch directories rather than files: saving a file often replaces it
+    set<fspath> directories;
+    for (const auto& p: paths) {
+        auto dir = fs::absolute(p).lexically_normal();
+        directories.insert(fs::is_directory(dir) ? dir : dir.parent_path());
+    }
+    for (auto it = _directoryWatches.begin(); it != _directoryWatches.end();)
+        if (!directories.contains(it->first)) {
+            inotify_rm_watch(_inotifyFd, it->second);
+            it = _directoryWatches.erase(it);
+        } else
+            ++it;
+    for (const auto& dir: directories)
+        if (!_directoryWatches.contains(dir))
+            if (const auto wd = inotify_add_watch(
+                    _inotifyFd, dir.c_str(),
+                    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE
+                        | IN_DELETE_SELF);
+                wd != -1)
+                _directoryWatches.emplace(dir, wd);
+#endif
+}
+
+set<FileWatcher::fspath> FileWatcher::changedFiles()
+{
+    set<fspath> result;
+    for (auto& [path, state]: _files)
+        if (auto newState = currentState(path); newState != state) {
+            state = newState;
+            result.insert(path);
+        }
+    return result;
+}
+
+void FileWatcher::waitForEvents()
+{
+#if __has_include(<sys/inotify.h>)
+    if (_inotifyFd != -1 && !_directoryWatches.empty()) {
+        pollfd pfd { _inotifyFd, POLLIN, 0 };
+        poll(&pfd, 1, PollingIntervalMs);
+        return;
+    }
+#endif
+    this_thread::sleep_for(chrono::milliseconds(PollingIntervalMs));
+}
+
+void FileWatcher::discardEvents()
+{
+#if __has_include(<sys/inotify.h>)
+    // The events themselves don't matter, only that there were some; but
+    // the watches of removed directories are gone, and watch() should add
+    // them anew once the directories are back
+    alignas(inotify_event) char buffer[4096];
+    if (_inotifyFd == -1)
+        return;
+    for (;;) {
+        const auto length = read(_inotifyFd, buffer, sizeof buffer);
+        if (length <= 0)
+            break;
+        for (auto* p = buffer; p < buffer + length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(p);
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF))
+                erase_if(_directoryWatches, [event](const auto& w) {
+                    return w.second == event->wd;
+                });
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif
+}
+
+set<FileWatcher::fspath> FileWatcher::waitForChanges()
+{
+    for (;;) {
+        waitForEvents();
+        discardEvents();
+        if (auto result = changedFiles(); !result.empty()) {
+            // Let the burst of changes (if it is one) finish
+            for (;;) {
+                this_thread::sleep_for(chrono::milliseconds(SettleTimeMs));
+                discardEvents();
+                auto moreFiles = changedFiles();
+                if (moreFiles.empty())
+                    return result;
+                result.merge(moreFiles);
+            }
+        }
+    }
+}
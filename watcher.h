@@ -0,0 +1,69 @@
+/******************************************************************************
+ * Copyright (C) 2026 GTAD contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <set>
+
+/// \brief Waits until any of a set of files (or directories) changes
+///
+/// Changes are detected by comparing modification times and sizes, so
+/// editors that save files by renaming a new one over the old one are
+/// handled too. Where inotify is available it is used to sleep until
+/// something happens in the directories of the watched files; elsewhere
+/// the files are polled a few times a second.
+class FileWatcher
+{
+public:
+    using fspath = std::filesystem::path;
+
+    FileWatcher();
+    ~FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /// \brief Replace the set of watched files with \p paths
+    ///
+    /// The current state of the files is taken as the unchanged one.
+    void watch(const std::set<fspath>& paths);
+    /// \brief Block until at least one of the watched files changes
+    ///
+    /// Changes made in a quick succession (as when saving several files at
+    /// once) are collected together.
+    /// \return the changed files, as they were passed to watch()
+    [[nodiscard]] std::set<fspath> waitForChanges();
+
+private:
+    struct FileState {
+        std::filesystem::file_time_type modificationTime;
+        std::uintmax_t size;
+        bool operator==(const FileState&) const = default;
+    };
+    std::map<fspath, FileState> _files;
+    int _inotifyFd = -1;
+    std::map<fspath, int> _directoryWatches;
+
+    static FileState currentState(const fspath& path);
+    [[nodiscard]] std::set<fspath> changedFiles();
+    /// Sleep until something happens in the watched directories
+    void waitForEvents();
+    void discardEvents();
+};
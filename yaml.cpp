@@ -18,10 +18,14 @@
 
 #include "yaml.h"
 
+#include "profiler.h"
+
 #include <yaml-cpp/node/parse.h>
 
-#include <regex>
 #include <functional>
+#include <istream>
+#include <optional>
+#include <streambuf>
 
 using Node = YAML::Node;
 using NodeType = YAML::NodeType;
@@ -71,30 +75,79 @@ std::vector<string> YamlSequence::asStrings() const
     return listVals;
 }
 
-YAML::Node makeNodeFromFile(const string& fileName,
-                            const pair_vector_t<string>& replacePairs)
-{
-    try {
-        if (replacePairs.empty())
-            return YAML::LoadFile(fileName);
-
-        string fileContents = readFile(fileName);
-        if (fileContents.empty())
-            throw YAML::BadFile(fileName);
-        for (const auto& subst: replacePairs)
-            fileContents = std::regex_replace(fileContents,
-                                 std::regex(subst.first), subst.second);
-        return YAML::Load(fileContents);
-    }
-    catch (YAML::BadFile &)
+/// An input stream buffer reading directly from memory
+struct MemoryStreamBuf : std::streambuf {
+    explicit MemoryStreamBuf(std::string_view s)
     {
-        throw Exception("Couldn't read YAML from input");
+        auto* const p = const_cast<char*>(s.data()); // Only read from
+        setg(p, p, p + s.size());
     }
+};
+
+YAML::Node makeNodeFromFile(const std::filesystem::path& fileName,
+                            const substitutions_t& substitutions)
+{
+    const auto& fileNameString = fileName.string();
+    std::optional<Profiler::Scope> profileScope { std::in_place, "substitute",
+                                                  fileNameString };
+    const FileContents fileContents { fileName };
+    Profiler::count(Profiler::FilesLoaded);
+    Profiler::count(Profiler::BytesLoaded,
+                    std::int64_t(fileContents.view().size()));
+    string buffer;
+    MemoryStreamBuf streamBuf {
+        applySubstitutions(fileContents.view(), substitutions, buffer)
+    };
+    profileScope.emplace("parse YAML", fileNameString);
+    std::istream is { &streamBuf };
+    return YAML::Load(is);
 }
 
 YamlMap YamlMap::loadFromFile(const std::filesystem::path& fileName,
-                              const pair_vector_t<std::string>& replacePairs)
+                              const substitutions_t& substitutions)
 {
-    return YamlNode(makeNodeFromFile(fileName.string(), replacePairs),
+    return YamlNode(makeNodeFromFile(fileName, substitutions),
                     std::make_shared<string>(fileName.string()));
 }
+
+std::string makeCacheKey(const std::string& canonicalPath,
+                         const substitutions_t& substitutions)
+{
+    auto key = canonicalPath;
+    for (const auto& s: substitutions)
+        ((key += '\0') += s.pattern) += '\0' + s.replacement;
+    return key;
+}
+
+YamlMap YamlDocumentCache::load(const std::filesystem::path& fileName,
+                                const substitutions_t& substitutions)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const auto canonicalPath = fs::canonical(fileName, ec).string();
+    if (ec) // Let loadFromFile() report the error
+        return YamlMap::loadFromFile(fileName, substitutions);
+    const auto modificationTime = fs::last_write_time(canonicalPath, ec);
+    const auto size = fs::file_size(canonicalPath, ec);
+    const auto cacheKey = makeCacheKey(canonicalPath, substitutions);
+    {
+        const std::lock_guard l(_mutex);
+        if (const auto it = _entries.find(cacheKey);
+            it != _entries.end() && it->second.modificationTime == modificationTime
+            && it->second.size == size)
+            return it->second.document;
+    }
+    // Parse outside of the lock so that different files are parsed in parallel
+    auto document = YamlMap::loadFromFile(fileName, substitutions);
+    const std::lock_guard l(_mutex);
+    // YAML::Node assignment changes the node in place, hence no assignment
+    _entries.erase(cacheKey);
+    _entries.emplace(cacheKey, Entry { modificationTime, size, document });
+    return document;
+}
+
+void YamlDocumentCache::clear()
+{
+    const std::lock_guard l(_mutex);
+    _entries.clear();
+}
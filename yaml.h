@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <filesystem>
+#include <unordered_map>
 #include <utility>
 
 // Mostly taken from yaml-cpp but stores and adds fileName to the returned values
@@ -227,8 +228,9 @@ class YamlMap : public YamlNodeTemplate<YamlNodePair, YAML::NodeType::Map>
 
         using my_type::YamlNodeTemplate;
 
+        /// \brief Load the file, applying substitutions before parsing
         static YamlMap loadFromFile(const std::filesystem::path& fileName,
-            const pair_vector_t<std::string>& replacePairs = {});
+            const substitutions_t& substitutions = {});
 
         template <typename KeyT>
         const YamlNode operator[](KeyT&& key) const
@@ -253,3 +255,29 @@ class YamlMap : public YamlNodeTemplate<YamlNodePair, YAML::NodeType::Map>
         }
 };
 
+/// \brief A thread-safe cache of YAML files parsed during the run
+///
+/// Documents are found by the canonical path of the file along with
+/// the substitutions applied to it (compared by their patterns and
+/// replacements, so that translators made from the same configuration share
+/// the documents) and are only reused while the file modification time and
+/// size stay the same. Cached documents are shared between the callers and
+/// should only be read.
+class YamlDocumentCache
+{
+    public:
+        /// \brief Find the document or load it with YamlMap::loadFromFile()
+        YamlMap load(const std::filesystem::path& fileName,
+                     const substitutions_t& substitutions);
+        /// Forget all documents, e.g. before the substitutions change
+        void clear();
+
+    private:
+        struct Entry {
+            std::filesystem::file_time_type modificationTime;
+            std::uintmax_t size;
+            YamlMap document;
+        };
+        std::mutex _mutex;
+        std::unordered_map<std::string, Entry> _entries;
+};